@@ -0,0 +1,89 @@
+# Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import argparse
+import json
+import os
+import sys
+
+import torch.nn as nn
+import yaml
+
+sys.path.insert(0, os.getcwd())
+
+from model_convert.model.fsmn import FSMN, toKaldiMatrix
+from model_convert.model.kws_model import init_model
+from model_convert.model.subsampling import NoSubsampling
+from model_convert.utils.checkpoint import load_checkpoint
+
+
+def get_args():
+    parser = argparse.ArgumentParser(
+        description='export a fsmn ctc model to a kaldi nnet, run natively '
+                    'by the runtime without onnxruntime')
+    parser.add_argument('--config', required=True, help='config file')
+    parser.add_argument('--checkpoint', required=True, help='checkpoint model')
+    parser.add_argument('--kaldi_net', required=True,
+                        help='output kaldi nnet text')
+    args = parser.parse_args()
+    return args
+
+
+def cmvn_to_kaldi_net(global_cmvn):
+    """<AddShift> and <Rescale> components of the global cmvn."""
+    mean = global_cmvn.mean.numpy()
+    dim = mean.shape[0]
+    re_str = '<AddShift> %d %d\n' % (dim, dim)
+    re_str += '<LearnRateCoef> 0 ' + toKaldiMatrix(-mean)
+    if global_cmvn.norm_var:
+        re_str += '<Rescale> %d %d\n' % (dim, dim)
+        re_str += '<LearnRateCoef> 0 ' + toKaldiMatrix(
+            global_cmvn.istd.numpy())
+    return re_str
+
+
+def main():
+    args = get_args()
+    if args.config.endswith("json"):
+        with open(args.config) as f:
+            configs = json.load(f)
+    else:
+        with open(args.config, 'r') as fin:
+            configs = yaml.load(fin, Loader=yaml.FullLoader)
+    model = init_model(configs['model'])
+    # The nnet holds the fsmn backbone and a softmax, the whole model of
+    # the ctc fsmn.
+    criterion = configs['training_config'].get('criterion', 'max_pooling')
+    if not isinstance(model.backbone, FSMN) or criterion != 'ctc' or \
+            not isinstance(model.preprocessing, NoSubsampling) or \
+            not isinstance(model.classifier, nn.Identity) or \
+            not isinstance(model.activation, nn.Identity):
+        print('Only the fsmn ctc models can be exported to a kaldi nnet')
+        sys.exit(1)
+
+    load_checkpoint(model, args.checkpoint)
+    model.eval()
+    net = model.backbone.to_kaldi_net()
+    if model.global_cmvn is not None:
+        # insert the cmvn ahead of the first component
+        head = '<Nnet>\n'
+        assert net.startswith(head)
+        net = head + cmvn_to_kaldi_net(model.global_cmvn) + net[len(head):]
+    with open(args.kaldi_net, 'w', encoding='utf8') as fout:
+        fout.write(net)
+    print('Export to {} succeed!'.format(args.kaldi_net))
+
+
+if __name__ == '__main__':
+    main()
@@ -69,12 +69,22 @@ def main():
                       args.onnx_model,
                       input_names=['input', 'cache'],
                       output_names=['output', 'r_cache'],
+                      # a dynamic batch axis lets the runtime stack the
+                      # chunks of many streams into one run
                       dynamic_axes={
                           'input': {
+                              0: 'B',
                               1: 'T'
                           },
+                          'cache': {
+                              0: 'B'
+                          },
                           'output': {
+                              0: 'B',
                               1: 'T'
+                          },
+                          'r_cache': {
+                              0: 'B'
                           }},
                       opset_version=13,
                       verbose=False,
@@ -0,0 +1,126 @@
+# Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import argparse
+import struct
+
+import numpy as np
+import onnx
+import onnxruntime as ort
+from onnxruntime.quantization import (CalibrationDataReader, QuantFormat,
+                                      QuantType, quantize_dynamic,
+                                      quantize_static)
+
+
+def get_args():
+    parser = argparse.ArgumentParser(
+        description='quantize an exported onnx model to int8')
+    parser.add_argument('--onnx_model', required=True,
+                        help='fp32 onnx model of export_onnx.py')
+    parser.add_argument('--quant_model', required=True,
+                        help='output int8 onnx model')
+    parser.add_argument('--mode', default='dynamic',
+                        choices=['dynamic', 'static'],
+                        help='dynamic quantizes the weights only, static '
+                             'the activations too, from calibration data')
+    parser.add_argument('--calib_feats',
+                        help='feature archive of compute_feats_main, '
+                             'required by the static mode')
+    parser.add_argument('--calib_num', type=int, default=200,
+                        help='number of calibration utterances')
+    parser.add_argument('--chunk_size', type=int, default=100,
+                        help='frames of the calibration chunks')
+    args = parser.parse_args()
+    if args.mode == 'static' and args.calib_feats is None:
+        parser.error('--calib_feats is required by the static mode')
+    return args
+
+
+def read_feature_archive(path, max_num):
+    """Features of a WKWSFEAT archive, see frontend/feature_archive.h."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'WKWSFEAT':
+        raise ValueError('{} is not a feature archive'.format(path))
+    _, num_entries, index_offset = struct.unpack_from('<IIQ', data, 8)
+    pos = index_offset
+    feats = []
+    for _ in range(min(num_entries, max_num)):
+        key_size, = struct.unpack_from('<I', data, pos)
+        pos += 4 + key_size
+        offset, rows, cols, compressed = struct.unpack_from('<QiiI', data,
+                                                            pos)
+        pos += 20
+        if compressed:
+            params = np.frombuffer(data, np.float32, 2 * cols, offset)
+            q = np.frombuffer(data, np.uint8, rows * cols,
+                              offset + 8 * cols).reshape(rows, cols)
+            mat = params[:cols] + params[cols:] * q.astype(np.float32)
+        else:
+            mat = np.frombuffer(data, np.float32, rows * cols,
+                                offset).reshape(rows, cols)
+        feats.append(mat.astype(np.float32))
+    return feats
+
+
+class StreamingDataReader(CalibrationDataReader):
+    """Chunks of the calibration utterances as the runtime feeds them, with
+    the cache the fp32 model carries from the previous chunk."""
+
+    def __init__(self, onnx_model, feats, chunk_size):
+        sess = ort.InferenceSession(onnx_model)
+        cache_shape = [1 if isinstance(d, str) else d
+                       for d in sess.get_inputs()[1].shape]
+        self.inputs = []
+        for mat in feats:
+            cache = np.zeros(cache_shape, dtype=np.float32)
+            for start in range(0, mat.shape[0], chunk_size):
+                chunk = mat[np.newaxis, start:start + chunk_size]
+                self.inputs.append({'input': chunk, 'cache': cache})
+                _, cache = sess.run(None, {'input': chunk, 'cache': cache})
+        self.iter = iter(self.inputs)
+
+    def get_next(self):
+        return next(self.iter, None)
+
+
+def main():
+    args = get_args()
+    if args.mode == 'dynamic':
+        quantize_dynamic(args.onnx_model, args.quant_model,
+                         weight_type=QuantType.QInt8)
+    else:
+        feats = read_feature_archive(args.calib_feats, args.calib_num)
+        reader = StreamingDataReader(args.onnx_model, feats, args.chunk_size)
+        quantize_static(args.onnx_model, args.quant_model, reader,
+                        quant_format=QuantFormat.QDQ, per_channel=True,
+                        activation_type=QuantType.QUInt8,
+                        weight_type=QuantType.QInt8)
+
+    # Keep cache_dim and cache_len, and mark the model as quantized for
+    # the runtime.
+    fp32_model = onnx.load(args.onnx_model)
+    quant_model = onnx.load(args.quant_model)
+    keys = set(meta.key for meta in quant_model.metadata_props)
+    for meta in fp32_model.metadata_props:
+        if meta.key not in keys:
+            quant_model.metadata_props.add().CopyFrom(meta)
+    meta = quant_model.metadata_props.add()
+    meta.key, meta.value = 'quantization', 'int8_' + args.mode
+    onnx.save(quant_model, args.quant_model)
+    print('Quantize to {} succeed!'.format(args.quant_model))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,84 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compute the features of every wav of a directory, keyed by wav path, or of
+// a manifest of "key path [label]" lines, keyed by key, once and write them
+// to a feature archive, e.g. for stream_kws_testing to only run the model on
+// each experiment. The archive records the pipeline config.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "frontend/feature_archive.h"
+#include "frontend/feature_pipeline.h"
+#include "frontend/wav.h"
+#include "kws/utils.h"
+#include "utils/log.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 5 && argc != 6) {
+        LOG(FATAL) << "Usage: compute_feats_main [solution_type, int] [num_bins, int] "
+                   << "[wave_dir or manifest, str] [archive_path, str] [compress, 0|1, default 0]";
+    }
+    const wenet::MODEL_TYPE mode_type = (wenet::MODEL_TYPE)std::stoi(argv[1]);
+    const int num_bins = std::stoi(argv[2]);
+    const std::string wave_dir = argv[3];
+    const std::string archive_path = argv[4];
+    const bool compress = argc == 6 && std::stoi(argv[5]) != 0;
+
+    std::vector<wekws::ManifestEntry> entries;
+    if (boost::filesystem::is_directory(wave_dir)) {
+        std::vector<std::string> wavepath;
+        wekws::process_directory(boost::filesystem::path(wave_dir), wavepath);
+        for (const std::string &wav_path : wavepath) {
+            entries.push_back(wekws::ManifestEntry{wav_path, wav_path, ""});
+        }
+    } else {
+        wekws::read_manifest(wave_dir, entries);
+    }
+
+    wenet::FeaturePipelineConfig feature_config(num_bins, 16000, mode_type);
+    wenet::FeatureArchiveWriter writer;
+    if (!writer.Open(archive_path, wenet::FeatureArchiveConfig(feature_config), compress)) {
+        LOG(FATAL) << "Failed to create " << archive_path;
+    }
+    std::vector<float> block;
+    for (const wekws::ManifestEntry &entry : entries) {
+        const std::string &wav_path = entry.path;
+        wenet::ChunkedWavReader reader;
+        if (!reader.Open(wav_path)) continue;
+        // a pipeline per wav, its config depends on the wav format
+        feature_config.input_sample_rate = reader.sample_rate();
+        feature_config.num_channels = reader.num_channel();
+        feature_config.channel = -1;
+        wenet::FeaturePipeline feature_pipeline(feature_config);
+        block.resize(reader.sample_rate() / 10 * reader.num_channel());
+        size_t n;
+        while ((n = reader.Next(block.data(), block.size())) > 0) {
+            feature_pipeline.AcceptWaveform(block.data(), n);
+        }
+        feature_pipeline.set_input_finished();
+        wenet::FeatureMatrix feats;
+        feature_pipeline.Read(feature_pipeline.NumQueuedFrames(), &feats);
+        if (!writer.Write(entry.key, feats)) {
+            LOG(FATAL) << "Failed to write " << archive_path;
+        }
+        std::cout << entry.key << " " << feats.num_rows() << " frames" << std::endl;
+    }
+    if (!writer.Close()) {
+        LOG(FATAL) << "Failed to write " << archive_path;
+    }
+    return 0;
+}
@@ -26,22 +26,25 @@ int main(int argc, char *argv[]) {
 
     std::string token_path, key_word;
     wenet::MODEL_TYPE mode_type;
+    int vad_arg = 0;  // index of the optional use_vad argument
 
     if (argc > 2){
         mode_type = (wenet::MODEL_TYPE)std::stoi(argv[1]);
         if(mode_type==wenet::CTC_TYPE_MODEL){
-            if (argc != 7) {
+            if (argc != 7 && argc != 8) {
                 LOG(FATAL) << "Usage: kws_main\n ./kws_main [solution_type, int] [num_bins, int] "
-                << "[batch_size, int] [model_path, str] [wave_path,str] [key_word,str]"   ;
+                << "[batch_size, int] [model_path, str] [wave_path,str] [key_word,str] [use_vad, int, optional]"   ;
             }
+            vad_arg = 7;
             // Input Arguments.
             key_word = argv[6];
             token_path = "../../kws/tokens.txt";
         } else if (mode_type == wenet::MAXPOOLING_TYPE_MODEL){
-            if (argc != 6) {
+            if (argc != 6 && argc != 7) {
                 LOG(FATAL) << "Usage: kws_main\n [solution_type, int] [num_bins, int] "
-                <<"[batch_size, int] [model_path, str] [wave_path,str]" ;
+                <<"[batch_size, int] [model_path, str] [wave_path,str] [use_vad, int, optional]" ;
             }
+            vad_arg = 6;
             token_path = "../../kws/maxpooling_keyword.txt";
         }
     }else{
@@ -57,65 +60,92 @@ int main(int argc, char *argv[]) {
     }
     const std::string model_path = argv[4];
     const std::string wav_path = argv[5];
+    // 1 skips the model on the frames without speech
+    const bool use_vad = argc > vad_arg && std::stoi(argv[vad_arg]) != 0;
 
+    // The file is read block by block, memory does not grow with its length.
     boost::filesystem::path wavpath(wav_path);
-    std::vector<float> wav;
+    wenet::ChunkedWavReader reader;
+    bool opened = false;
     if (wavpath.extension() == ".wav"){
-        // audio reader
-        wenet::WavReader wav_reader(wav_path);
-        int num_samples = wav_reader.num_samples();
-        wav.assign(wav_reader.data(), wav_reader.data() + num_samples);
+        opened = reader.Open(wav_path);
     }else if (wavpath.extension() == ".pcm"){
-        read_pcm(wav_path, wav);
+        opened = reader.OpenPcm(wav_path);  // 16k mono
     }else{
         LOG(FATAL) << "Not support format = " << wavpath.extension();
     }
+    if (!opened) {
+        LOG(FATAL) << "Failed to read " << wav_path;
+    }
 
     // Setting config for handling waveform of audio, convert it to mel spectrogram of audio.
     // Only support CTC_TYPE_MODEL.
     wenet::FeaturePipelineConfig feature_config(num_bins, 16000, mode_type);
+    feature_config.use_vad = use_vad;
+    feature_config.input_sample_rate = reader.sample_rate();  // resampled to 16k
+    feature_config.num_channels = reader.num_channel();
+    feature_config.channel = -1;  // downmix multi-channel wav
     wenet::FeaturePipeline feature_pipeline(feature_config);
-    feature_pipeline.AcceptWaveform(wav);
-    feature_pipeline.set_input_finished();
 
-    wekws::KeywordSpotting spotter(model_path, wekws::DECODE_PREFIX_BEAM_SEARCH, mode_type);
-    spotter.readToken(token_path);
-    if(mode_type==1){
+    auto model = wekws::KwsModel::FromMappedFile(model_path, mode_type);
+    model->readToken(token_path);
+    if (mode_type == 1) {
         // set keyword
-        spotter.setKeyWord(key_word);
+        model->setKeyWord(key_word);
     }
+    wekws::KwsStream spotter(model, wekws::DECODE_PREFIX_BEAM_SEARCH);
 
-    // Simulate streaming, detect batch by batch
+    // Feed the pipeline 100ms at a time and detect the complete batches as
+    // soon as they are queued, the rest once the input is finished.
+    std::vector<float> block(reader.sample_rate() / 10 * reader.num_channel());
     int offset = 0;
-    while (true) {
-        std::vector<std::vector<float>> feats;
-        bool ok = feature_pipeline.Read(batch_size, &feats);
-        std::vector<std::vector<float>> probs; //
-        spotter.Forward(feats, &probs);
+    bool done = false;
+    while (!done) {
+        size_t n = reader.Next(block.data(), block.size());
+        if (n > 0) {
+            feature_pipeline.AcceptWaveform(block.data(), n);
+        } else {
+            feature_pipeline.set_input_finished();
+        }
+        while (feature_pipeline.input_finished() ||
+               feature_pipeline.NumReadyFrames() >= batch_size) {
+            wenet::FeatureMatrix feats;
+            bool has_speech = true;
+            bool ok = feature_pipeline.Read(batch_size, &feats, &has_speech);
+            done = !ok;
+            if (!has_speech) {
+                spotter.SkipNonSpeech(feats.num_rows());
+                offset += feats.num_rows();
+                if (!ok) break;
+                continue;
+            }
+            wenet::FeatureView probs;
+            spotter.Forward(feats, &probs);
 
-        if(mode_type==1){
-            // Reach the end of feature pipeline
-            spotter.decode_keywords(probs, 0.2);
-            // 每次唤醒检测结果，保存在全局变量 spotter.kwsInfo中。
+            if(mode_type==1){
+                // Reach the end of feature pipeline
+                spotter.decode_keywords(probs, 0.2);
+                // 每次唤醒检测结果，保存在全局变量 spotter.kwsInfo中。
 
-        }else{
-            int flag = 0;
-            float threshold = 0.8; // > threshold  means keyword activated. < threshold means not.
-            for (int i = 0; i < probs.size(); i++) {
-                std::cout << "frame " << offset + i << " prob";
-                for (int j = 0; j < probs[i].size(); j++) { // size()=number of keywords.
+            }else{
+                int flag = 0;
+                float threshold = 0.8; // > threshold  means keyword activated. < threshold means not.
+                for (int i = 0; i < probs.num_rows(); i++) {
+                    std::cout << "frame " << offset + i << " prob";
+                    for (int j = 0; j < probs.num_cols(); j++) { // num_cols()=number of keywords.
 
-                    std::cout << " " << probs[i][j];
-                    if (probs[i][j] > threshold){
-                        std::cout << " activated keyword: " << spotter.mmaxpooling_keywords[j] << " ";
+                        std::cout << " " << probs.Row(i)[j];
+                        if (probs.Row(i)[j] > threshold){
+                            std::cout << " activated keyword: " << model->maxpooling_keywords()[j] << " ";
+                        }
                     }
+                    std::cout << std::endl;
                 }
-                std::cout << std::endl;
             }
-        }
 
-        if (!ok) break;
-        offset += probs.size();
+            if (!ok) break;
+            offset += probs.num_rows();
+        }
     }
     return 0;
 }
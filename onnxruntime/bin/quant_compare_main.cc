@@ -0,0 +1,174 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compare an int8 model of quantize_onnx.py with its fp32 model on the wavs
+// of a directory: the real time factor of the model runs, the agreement of
+// the detections per wav and the difference of the output probabilities.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frontend/feature_pipeline.h"
+#include "frontend/wav.h"
+#include "kws/keyword_spotting.h"
+#include "kws/utils.h"
+#include "utils/log.h"
+#include "utils/timer.h"
+
+// Model time and detections of one model over a wav.
+struct Detection {
+    double forward_ms = 0.0;
+    bool ctc_activated = false;
+    // max-pooling model, keywords over the threshold
+    std::vector<bool> activated;
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 7) {
+        LOG(FATAL) << "Usage: quant_compare_main [solution_type, int] [num_bins, int] "
+                   << "[batch_size, int] [fp32_model, str] [int8_model, str] [wave_dir, str] "
+                   << "[key_word, str, ctc only]";
+    }
+    const wenet::MODEL_TYPE mode_type = (wenet::MODEL_TYPE)std::stoi(argv[1]);
+    const int num_bins = std::stoi(argv[2]);
+    const int batch_size = std::stoi(argv[3]);
+    const std::string model_paths[2] = {argv[4], argv[5]};
+    const std::string wave_dir = argv[6];
+    std::string key_word, token_path;
+    if (mode_type == wenet::CTC_TYPE_MODEL) {
+        if (argc != 8) LOG(FATAL) << "The ctc models need a key_word";
+        key_word = argv[7];
+        token_path = "../../kws/tokens.txt";
+    } else {
+        token_path = "../../kws/maxpooling_keyword.txt";
+    }
+    if (batch_size < 1) {
+        LOG(FATAL) << "batch_size should greater than 0, it's equal to " << batch_size << "now";
+    }
+    const float threshold = 0.8;  // max-pooling activation
+
+    std::shared_ptr<wekws::KwsModel> models[2];
+    for (int m = 0; m < 2; m++) {
+        models[m] = wekws::KwsModel::FromMappedFile(model_paths[m], mode_type);
+        models[m]->readToken(token_path);
+        if (mode_type == wenet::CTC_TYPE_MODEL) models[m]->setKeyWord(key_word);
+    }
+    if (models[1]->output_dim() != models[0]->output_dim()) {
+        LOG(FATAL) << "The two models have different outputs";
+    }
+    if (!models[1]->is_quantized()) {
+        LOG(WARNING) << model_paths[1] << " is not marked as a quantized model";
+    }
+
+    std::vector<std::string> wavepath;
+    wekws::process_directory(boost::filesystem::path(wave_dir), wavepath);
+
+    wenet::FeaturePipelineConfig feature_config(num_bins, 16000, mode_type);
+    double audio_seconds = 0.0, forward_ms[2] = {0.0, 0.0};
+    double max_diff = 0.0, sum_diff = 0.0;
+    int64_t num_probs = 0;
+    int num_wavs = 0, num_agree = 0, num_detected[2] = {0, 0};
+    std::vector<float> block;
+    for (const std::string &wav_path : wavepath) {
+        // 1. Features of the whole wav, shared by the two models.
+        wenet::ChunkedWavReader reader;
+        if (!reader.Open(wav_path)) continue;
+        feature_config.input_sample_rate = reader.sample_rate();
+        feature_config.num_channels = reader.num_channel();
+        feature_config.channel = -1;
+        wenet::FeaturePipeline feature_pipeline(feature_config);
+        block.resize(reader.sample_rate() / 10 * reader.num_channel());
+        size_t n, num_samples = 0;
+        while ((n = reader.Next(block.data(), block.size())) > 0) {
+            feature_pipeline.AcceptWaveform(block.data(), n);
+            num_samples += n;
+        }
+        feature_pipeline.set_input_finished();
+        wenet::FeatureMatrix feats;
+        feature_pipeline.Read(feature_pipeline.NumQueuedFrames(), &feats);
+        audio_seconds += static_cast<double>(num_samples) /
+                         (reader.sample_rate() * reader.num_channel());
+
+        // 2. Stream the two models chunk by chunk, side by side.
+        std::unique_ptr<wekws::KwsStream> streams[2];
+        Detection detections[2];
+        for (int m = 0; m < 2; m++) {
+            streams[m].reset(new wekws::KwsStream(models[m], wekws::DECODE_PREFIX_BEAM_SEARCH));
+            detections[m].activated.assign(models[m]->output_dim(), false);
+        }
+        for (int row = 0; row < feats.num_rows(); row += batch_size) {
+            wenet::FeatureView chunk = wenet::FeatureView(feats).Rows(
+                    row, std::min(batch_size, feats.num_rows() - row));
+            wenet::FeatureView probs[2];
+            for (int m = 0; m < 2; m++) {
+                wenet::Timer timer;
+                streams[m]->Forward(chunk, &probs[m]);
+                detections[m].forward_ms += timer.Elapsed();
+            }
+            for (int i = 0; i < probs[0].num_rows(); i++) {
+                for (int j = 0; j < probs[0].num_cols(); j++) {
+                    double diff = std::fabs(probs[0].Row(i)[j] - probs[1].Row(i)[j]);
+                    max_diff = std::max(max_diff, diff);
+                    sum_diff += diff;
+                }
+            }
+            num_probs += static_cast<int64_t>(probs[0].num_rows()) * probs[0].num_cols();
+            for (int m = 0; m < 2; m++) {
+                if (mode_type == wenet::CTC_TYPE_MODEL) {
+                    streams[m]->decode_keywords(probs[m]);
+                    if (streams[m]->kwsInfo.state) detections[m].ctc_activated = true;
+                } else {
+                    for (int i = 0; i < probs[m].num_rows(); i++) {
+                        for (int j = 0; j < probs[m].num_cols(); j++) {
+                            if (probs[m].Row(i)[j] > threshold) detections[m].activated[j] = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        // 3. Per wav agreement of the detections.
+        bool detected[2];
+        for (int m = 0; m < 2; m++) {
+            forward_ms[m] += detections[m].forward_ms;
+            detected[m] = detections[m].ctc_activated ||
+                          std::count(detections[m].activated.begin(),
+                                     detections[m].activated.end(), true) > 0;
+            num_detected[m] += detected[m];
+        }
+        bool agree = detections[0].ctc_activated == detections[1].ctc_activated &&
+                     detections[0].activated == detections[1].activated;
+        num_agree += agree;
+        num_wavs++;
+        std::cout << (agree ? "SAME ：" : "DIFF ：") << wav_path
+                  << "\tfp32 " << detected[0] << " int8 " << detected[1] << std::endl;
+    }
+    if (num_wavs == 0) LOG(FATAL) << "No wav in " << wave_dir;
+
+    // RTF of the model runs only, the features and decoding are the same.
+    const double rtf[2] = {forward_ms[0] / 1000.0 / audio_seconds,
+                           forward_ms[1] / 1000.0 / audio_seconds};
+    std::cout << "wavs: " << num_wavs << " audio: " << audio_seconds << "s" << std::endl
+              << "fp32 RTF: " << rtf[0] << " int8 RTF: " << rtf[1]
+              << " speedup: " << rtf[0] / rtf[1] << std::endl
+              << "detections fp32: " << num_detected[0] << " int8: " << num_detected[1]
+              << " agreement: " << num_agree << "/" << num_wavs << std::endl
+              << "prob diff max: " << max_diff
+              << " mean: " << (num_probs > 0 ? sum_diff / num_probs : 0.0) << std::endl;
+    return 0;
+}
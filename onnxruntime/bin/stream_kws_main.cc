@@ -38,8 +38,7 @@ static int RecordCallback(const void *input, void *output,
                           const PaStreamCallbackTimeInfo *time_info,
                           PaStreamCallbackFlags status_flags, void *user_data) {
     const auto *pcm_data = static_cast<const int16_t *>(input);
-    std::vector<int16_t> v(pcm_data, pcm_data + frames_count);
-    g_feature_pipeline->AcceptWaveform(v);
+    g_feature_pipeline->AcceptWaveform(pcm_data, frames_count);
 
     if (g_exiting) {
         LOG(INFO) << "Exiting loop.";
@@ -54,20 +53,23 @@ int main(int argc, char *argv[]) {
     std::string token_path;
     std::string key_word;
     wenet::MODEL_TYPE mode_type;
+    int vad_arg = 0;  // index of the optional use_vad argument
     if (argc > 2) {
         mode_type = (wenet::MODEL_TYPE) std::stoi(argv[1]);
         if (mode_type == wenet::CTC_TYPE_MODEL) {
-            if (argc != 6) {
+            if (argc != 6 && argc != 7) {
                 LOG(FATAL) << "Usage: ./stream_kws_main\n [solution_type, int] [num_bins, int] [batch_size, int]"
-                           << "[model_path, str] [key_word,str]";
+                           << "[model_path, str] [key_word,str] [use_vad, int, optional]";
             }
+            vad_arg = 6;
             key_word = argv[5];
             token_path = "../../kws/tokens.txt";
         } else if (mode_type == wenet::MAXPOOLING_TYPE_MODEL) {
-            if (argc != 5) {
+            if (argc != 5 && argc != 6) {
                 LOG(FATAL) << "Usage: ./stream_kws_main\n [solution_type, int] [num_bins, int] [batch_size, int]"
-                           << "[model_path, str]";
+                           << "[model_path, str] [use_vad, int, optional]";
             }
+            vad_arg = 5;
             token_path = "../../kws/maxpooling_keyword.txt";
         }
     } else {
@@ -82,15 +84,19 @@ int main(int argc, char *argv[]) {
         LOG(FATAL) << "batch_size should greater than 3, it's equal to " << batch_size << "now";
     }
     const std::string model_path = argv[4];
+    // 1 skips the model on the frames without speech
+    const bool use_vad = argc > vad_arg && std::stoi(argv[vad_arg]) != 0;
 
     wenet::FeaturePipelineConfig feature_config(num_bins, 16000, mode_type);
+    feature_config.use_vad = use_vad;
     g_feature_pipeline = std::make_shared<wenet::FeaturePipeline>(feature_config);
-    wekws::KeywordSpotting spotter(model_path, wekws::DECODE_PREFIX_BEAM_SEARCH, mode_type);
-    spotter.readToken(token_path);
+    auto model = wekws::KwsModel::FromMappedFile(model_path, mode_type);
+    model->readToken(token_path);
     if (mode_type == 1) {
         // set keyword
-        spotter.setKeyWord(key_word);
+        model->setKeyWord(key_word);
     }
+    wekws::KwsStream spotter(model, wekws::DECODE_PREFIX_BEAM_SEARCH);
 
     signal(SIGINT, SigRoutine);
     PaError err = Pa_Initialize();
@@ -119,9 +125,14 @@ int main(int argc, char *argv[]) {
 
     while (Pa_IsStreamActive(stream)) {
         Pa_Sleep(interval);
-        std::vector<std::vector<float>> feats;
-        g_feature_pipeline->Read(batch_size, &feats);
-        std::vector<std::vector<float>> probs;
+        wenet::FeatureMatrix feats;
+        bool has_speech = true;
+        g_feature_pipeline->Read(batch_size, &feats, &has_speech);
+        if (!has_speech) {
+            spotter.SkipNonSpeech(feats.num_rows());
+            continue;
+        }
+        wenet::FeatureView probs;
         spotter.Forward(feats, &probs);
 
         // detection key-words
@@ -130,13 +141,13 @@ int main(int argc, char *argv[]) {
             spotter.decode_keywords(probs, hitScoreThr);
 
         } else {
-            for (int t = 0; t < probs.size(); t++) {
+            for (int t = 0; t < probs.num_rows(); t++) {
                 std::cout << "keywords prob:";
-                for (int i = 0; i < probs[t].size(); i++) {
-                    if (probs[t][i] > 0.8) {
-                        std::cout << " kw[" << i << "] " << probs[t][i];
+                for (int i = 0; i < probs.num_cols(); i++) {
+                    if (probs.Row(t)[i] > 0.8) {
+                        std::cout << " kw[" << i << "] " << probs.Row(t)[i];
                     }
-                    //std::cout << " kw[" << i << "] " << probs[t][i];
+                    //std::cout << " kw[" << i << "] " << probs.Row(t)[i];
                 }
                 std::cout << std::endl;
             }
@@ -15,6 +15,8 @@
 //.
 
 
+#include "frontend/audio_prefetcher.h"
+#include "frontend/feature_archive.h"
 #include "frontend/feature_pipeline.h"
 #include "frontend/wav.h"
 #include "kws/keyword_spotting.h"
@@ -35,67 +37,141 @@ int main(int argc, char *argv[]) {
     const std::string token_path = "../../kws/tokens.txt";
     const std::string test_dir = argv[4];
     const int interval = std::stoi(argv[5]); // 每次输入多少ms的音频数据
+    // Optional feature archive of compute_feats_main, to only run the model.
+    const std::string archive_path = argc > 6 ? argv[6] : "";
+    wenet::FeatureMatrix archive_buffer;
 
     // Setting config for handling waveform of audio, convert it to mel spectrogram of audio.
     // Only support CTC_TYPE_MODEL.
-    wekws::KeywordSpotting spotter(model_path, wekws::DECODE_PREFIX_BEAM_SEARCH, 1);
-    spotter.readToken(token_path);
-    spotter.setKeyWord(key_word);
-
-    std::vector<std::string> wavepath;
-    // walk path, collection all wave file.
-    boost::filesystem::path directory(test_dir);
-    process_directory(directory, wavepath);
+    auto model = wekws::KwsModel::FromMappedFile(model_path, 1);
+    model->readToken(token_path);
+    model->setKeyWord(key_word);
+    wekws::KwsStream spotter(model, wekws::DECODE_PREFIX_BEAM_SEARCH);
+
+    // test_dir is a directory walked for its wav files, all of them holding
+    // the keyword, or a manifest of "key path [label]" lines, a label other
+    // than the keyword marks a negative utterance.
+    std::vector<ManifestEntry> entries;
+    if (boost::filesystem::is_directory(test_dir)) {
+        std::vector<std::string> wavepath;
+        // walk path, collection all wave file.
+        process_directory(boost::filesystem::path(test_dir), wavepath);
+        for (const std::string &wav_path : wavepath) {
+            entries.push_back(ManifestEntry{wav_path, wav_path, key_word});
+        }
+    } else {
+        read_manifest(test_dir, entries);
+    }
+    std::vector<std::string> paths;
+    for (const ManifestEntry &entry : entries) paths.push_back(entry.path);
+
+    // Loader threads read and decode the files ahead of the model, unless
+    // the features are cached.
+    std::unique_ptr<wenet::AudioPrefetcher> prefetcher;
+    if (archive_path.empty()) {
+        prefetcher.reset(new wenet::AudioPrefetcher(paths, 4, 16));
+    }
 
     wenet::FeaturePipelineConfig feature_config(num_bins, 16000, wenet::CTC_TYPE_MODEL);
-    wenet::FeaturePipeline feature_pipeline(feature_config);
-    feature_pipeline.set_input_finished();
+    feature_config.channel = -1;  // downmix multi-channel wav
+    // Rebuilt when the wav format changes, reset between the files.
+    std::unique_ptr<wenet::FeaturePipeline> feature_pipeline;
+    // The archive is keyed like the entries, and must have been computed
+    // with the same pipeline config.
+    wenet::FeatureArchiveReader archive;
+    if (!archive_path.empty() &&
+        !archive.Open(archive_path, wenet::FeatureArchiveConfig(feature_config))) {
+        LOG(FATAL) << "Failed to read " << archive_path;
+    }
 
-    int TP = 0, FN = 0;
+    int TP = 0, FN = 0, FP = 0, TN = 0;
     std::vector<std::string> errorCases;
-    for (const std::string wav_path: wavepath) {
-
-        // audio reader
-        wenet::WavReader wav_reader(wav_path);
-        int num_samples = wav_reader.num_samples();
-        std::vector<float> wav1(wav_reader.data(), wav_reader.data() + num_samples);
-
-        int count = 0;
-        //分段传入, 每100ms传入一次数据，100ms=100*(16000/1000)=1600nums, 100ms=1600*2=3200 bytes。
-        std::vector<float> wav;
+    wenet::PrefetchedAudio audio;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        size_t index = i;
+        if (prefetcher != nullptr) {
+            prefetcher->Next(&audio);
+            index = audio.index;
+        }
+        const std::string &wav_path = entries[index].path;
         spotter.reset_value();
         spotter.stepClear();
         int numBytes = 0;
         bool flag = false;
-        // Simulate streaming, detect batch by batch
-        while (!wav1.empty()){
-            wav.push_back(wav1.front());
-            wav1.erase(wav1.begin());
-            count +=1;
-            if (count < interval*16 && !wav1.empty() ) {
+
+        if (prefetcher == nullptr) {
+            // Cached features, read in place unless compressed, and fed
+            // batch by batch as the pipeline gives them.
+            wenet::FeatureView feats;
+            const std::string &key = entries[index].key;
+            if (!archive.Get(key, &archive_buffer, &feats)) {
+                LOG(WARNING) << "No features of " << key << " in " << archive_path;
                 continue;
-            }else{
-                count = 0;
             }
-            numBytes += wav.size();
-            feature_pipeline.AcceptWaveform(wav);
-            wav.clear();
-
-            while (true) {
-                std::vector<std::vector<float>> feats;
-
-                bool ok = feature_pipeline.Read(batch_size, &feats);
-                std::vector<std::vector<float>> probs; //
-
-                spotter.Forward(feats, &probs);
-                std::cout << "feats.size= " << feats.size() << " probs.size=" << probs.size() << std::endl;
-                // Reach the end of feature pipeline
-                spotter.decode_keywords(probs); // feature_config.downsampling
+            for (int row = 0; row < feats.num_rows(); row += batch_size) {
+                wenet::FeatureView probs;
+                spotter.Forward(feats.Rows(row, std::min(batch_size, feats.num_rows() - row)), &probs);
+                spotter.decode_keywords(probs);
                 if (spotter.kwsInfo.state) flag = true;
-                if (!ok) break;
+            }
+        } else if (!audio.ok) {
+            continue;
+        } else {
+            // The pipeline resamples the wav to 16k and downmixes it, as
+            // compute_feats_main does.
+            if (feature_pipeline == nullptr ||
+                feature_config.input_sample_rate != audio.sample_rate ||
+                feature_config.num_channels != audio.num_channel) {
+                feature_pipeline.reset();
+                feature_config.input_sample_rate = audio.sample_rate;
+                feature_config.num_channels = audio.num_channel;
+                feature_pipeline.reset(new wenet::FeaturePipeline(feature_config));
+            } else {
+                feature_pipeline->Reset();
+            }
+
+            //分段传入, 每interval ms传入一次数据, 如100ms=100*(16000/1000)=1600nums。
+            const size_t chunk = std::max<size_t>(
+                    static_cast<size_t>(interval) * audio.sample_rate / 1000 * audio.num_channel, 1);
+            // Simulate streaming, detect batch by batch as soon as they are
+            // queued, the rest once the file is finished.
+            size_t pos = 0;
+            bool done = false;
+            while (!done) {
+                if (pos < audio.samples.size()) {
+                    size_t n = std::min(chunk, audio.samples.size() - pos);
+                    numBytes += n;
+                    feature_pipeline->AcceptWaveform(audio.samples.data() + pos, n);
+                    pos += n;
+                } else {
+                    feature_pipeline->set_input_finished();
+                }
+                while (feature_pipeline->input_finished() ||
+                       feature_pipeline->NumReadyFrames() >= batch_size) {
+                    wenet::FeatureMatrix feats;
+                    bool ok = feature_pipeline->Read(batch_size, &feats);
+                    wenet::FeatureView probs;
+                    spotter.Forward(feats, &probs);
+                    spotter.decode_keywords(probs); // feature_config.downsampling
+                    if (spotter.kwsInfo.state) flag = true;
+                    // Reach the end of feature pipeline
+                    if (!ok) {
+                        done = true;
+                        break;
+                    }
+                }
             }
         }
-        if (flag) {
+        bool positive = entries[index].label.empty() || entries[index].label == key_word;
+        if (!positive) {
+            if (flag) {
+                FP += 1;
+                errorCases.push_back(wav_path);
+            } else {
+                TN += 1;
+            }
+            std::cout << (flag ? "FA ：" : "NEG ：") << wav_path << "\t" << numBytes << std::endl;
+        } else if (flag) {
             TP += 1;
             // find keyword in predicted sequence.
             std::cout << "YES ：" << wav_path << "\t" << numBytes << std::endl;
@@ -107,10 +183,12 @@ int main(int argc, char *argv[]) {
     }
 
     // compute metric
-    std::cout << "TP: " << TP << " FN: " << FN << std::endl;
+    std::cout << "TP: " << TP << " FN: " << FN;
+    if (FP + TN > 0) std::cout << " FP: " << FP << " TN: " << TN;
+    std::cout << std::endl;
     // save bad case
     std::string badcasePath = "test.txt";
     writeVectorToFile(errorCases, badcasePath);
 
     return 0;
-};
\ No newline at end of file
+};
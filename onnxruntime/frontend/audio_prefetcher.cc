@@ -0,0 +1,83 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/audio_prefetcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "frontend/wav.h"
+#include "utils/log.h"
+
+namespace wenet {
+
+namespace {
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+AudioPrefetcher::AudioPrefetcher(const std::vector<std::string>& paths,
+                                 int num_threads, int queue_size)
+    : paths_(paths), queue_(queue_size), next_(0), num_returned_(0) {
+  CHECK(num_threads > 0 && queue_size > 0);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&AudioPrefetcher::Load, this);
+  }
+}
+
+AudioPrefetcher::~AudioPrefetcher() {
+  // Every index claimed before this exchange is pushed exactly once, pop
+  // the ones not returned yet to unblock their loaders.
+  size_t claimed = std::min(next_.exchange(paths_.size()), paths_.size());
+  for (size_t i = num_returned_; i < claimed; ++i) queue_.Pop();
+  for (std::thread& thread : threads_) thread.join();
+}
+
+void AudioPrefetcher::Load() {
+  size_t index;
+  while ((index = next_.fetch_add(1)) < paths_.size()) {
+    const std::string& path = paths_[index];
+    PrefetchedAudio audio;
+    audio.index = index;
+    ChunkedWavReader reader;
+    audio.ok = EndsWith(path, ".pcm") ? reader.OpenPcm(path) : reader.Open(path);
+    if (audio.ok) {
+      audio.sample_rate = reader.sample_rate();
+      audio.num_channel = reader.num_channel();
+      // 1s blocks, read straight into the end of samples
+      const size_t block = audio.sample_rate * audio.num_channel;
+      size_t size = 0, n;
+      do {
+        audio.samples.resize(size + block);
+        n = reader.Next(audio.samples.data() + size, block);
+        size += n;
+      } while (n > 0);
+      audio.samples.resize(size);
+    }
+    queue_.Push(std::move(audio));
+  }
+}
+
+bool AudioPrefetcher::Next(PrefetchedAudio* audio) {
+  if (num_returned_ == paths_.size()) return false;
+  *audio = queue_.Pop();
+  ++num_returned_;
+  return true;
+}
+
+}  // namespace wenet
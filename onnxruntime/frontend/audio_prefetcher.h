@@ -0,0 +1,70 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_AUDIO_PREFETCHER_H_
+#define FRONTEND_AUDIO_PREFETCHER_H_
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/blocking_queue.h"
+
+namespace wenet {
+
+// A decoded audio file.
+struct PrefetchedAudio {
+  size_t index = 0;  // in the paths given to the prefetcher
+  bool ok = false;   // false if the file could not be read
+  int sample_rate = 0;
+  int num_channel = 0;
+  std::vector<float> samples;  // interleaved when there are several channels
+};
+
+// Pool of loader threads reading and decoding audio files ahead of their
+// consumer, so that the file open and read latency, e.g. of a network file
+// system, overlaps the inference. At most queue_size decoded files wait in
+// a bounded queue, the loaders block when it is full. .pcm files are read as
+// 16k mono 16 bits pcm, the others as wav.
+class AudioPrefetcher {
+ public:
+  AudioPrefetcher(const std::vector<std::string>& paths, int num_threads,
+                  int queue_size);
+
+  // Stop the loaders, the files not returned yet are dropped.
+  ~AudioPrefetcher();
+
+  // Next decoded file, in completion order, so audio->index tells which one
+  // it is. Return false when all of them were returned.
+  bool Next(PrefetchedAudio* audio);
+
+ private:
+  void Load();
+
+  const std::vector<std::string> paths_;
+  BlockingQueue<PrefetchedAudio> queue_;
+  // next path to load, paths_.size() once stopped
+  std::atomic<size_t> next_;
+  // files returned by Next()
+  size_t num_returned_;
+  std::vector<std::thread> threads_;
+
+ public:
+  WENET_DISALLOW_COPY_AND_ASSIGN(AudioPrefetcher);
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_AUDIO_PREFETCHER_H_
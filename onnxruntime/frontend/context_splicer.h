@@ -0,0 +1,131 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_CONTEXT_SPLICER_H_
+#define FRONTEND_CONTEXT_SPLICER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "frontend/feature_matrix.h"
+#include "utils/log.h"
+
+namespace wenet {
+
+// Streaming context expansion and downsampling of the fbank frames fed to
+// the ctc models. Output frame t is the concatenation of fbank frames
+// [t - left_context, t + right_context], the stream start is padded with
+// copies of its first frame, and only every step-th output is kept. The
+// downsampling phase is carried across calls, so the kept frames do not
+// depend on how the input is chunked.
+//
+// The fbank frames are appended to frames(), after the left_context +
+// right_context previous frames kept as context, so a spliced frame is
+// left_context + right_context + 1 contiguous rows and only the kept ones
+// are materialized, with one copy each.
+class ContextSplicer {
+ public:
+  ContextSplicer(int dim, int left_context, int right_context, int step)
+      : left_context_(left_context),
+        right_context_(right_context),
+        step_(step),
+        frames_(0, dim) {
+    CHECK(step_ > 0);
+    Reset();
+  }
+
+  int dim() const { return frames_.num_cols(); }
+  int output_dim() const {
+    return dim() * (left_context_ + right_context_ + 1);
+  }
+
+  // Buffer the fbank frames are appended to, and their speech flags.
+  FeatureMatrix* frames() { return &frames_; }
+  std::vector<uint8_t>* speech() { return &speech_; }
+
+  // Splice the kept frames that the appended frames complete and append
+  // them to out, return their number. A kept frame has the speech flag of
+  // its center frame. The frames that are no longer needed as context are
+  // dropped.
+  int Splice(FeatureFifo* out) {
+    CHECK(out->num_cols() == output_dim());
+    CHECK(static_cast<int>(speech_.size()) == frames_.num_rows());
+    if (!started_) {
+      if (frames_.empty()) return 0;
+      // Pad the stream start with left_context copies of its first frame.
+      int n = frames_.num_rows();
+      frames_.AppendRows(left_context_);
+      memmove(frames_.Row(left_context_), frames_.Row(0),
+              sizeof(float) * n * dim());
+      for (int i = 0; i < left_context_; ++i) {
+        memcpy(frames_.Row(i), frames_.Row(left_context_),
+               sizeof(float) * dim());
+      }
+      speech_.insert(speech_.begin(), left_context_, speech_[0]);
+      started_ = true;
+    }
+    // Centers of the complete frames are [next_, end).
+    int end = frames_.num_rows() - right_context_;
+    if (end <= next_) return 0;
+    int first = next_ + (step_ - phase_) % step_;
+    int num_kept = first < end ? (end - 1 - first) / step_ + 1 : 0;
+    phase_ = (phase_ + end - next_) % step_;
+    kept_speech_.resize(num_kept);
+    for (int i = 0; i < num_kept; ++i) {
+      kept_speech_[i] = speech_[first + i * step_];
+    }
+    float* dst = out->AppendRows(num_kept, kept_speech_.data());
+    const int size = output_dim();
+    for (int i = 0; i < num_kept; ++i) {
+      memcpy(dst + i * size, frames_.Row(first + i * step_ - left_context_),
+             sizeof(float) * size);
+    }
+    // Keep the frames still needed as context of the next centers.
+    int drop = end - left_context_;
+    int keep = frames_.num_rows() - drop;
+    memmove(frames_.data(), frames_.Row(drop), sizeof(float) * keep * dim());
+    frames_.Resize(keep, dim());
+    speech_.erase(speech_.begin(), speech_.begin() + drop);
+    next_ = left_context_;
+    return num_kept;
+  }
+
+  void Reset() {
+    frames_.Clear();
+    speech_.clear();
+    started_ = false;
+    next_ = left_context_;
+    phase_ = 0;
+  }
+
+ private:
+  int left_context_;
+  int right_context_;
+  int step_;
+  // context frames followed by the appended ones
+  FeatureMatrix frames_;
+  std::vector<uint8_t> speech_;
+  // speech flags of the frames kept by one Splice() call
+  std::vector<uint8_t> kept_speech_;
+  bool started_;
+  // row of frames_ of the next center
+  int next_;
+  // number of centers since the last kept one, modulo step_
+  int phase_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_CONTEXT_SPLICER_H_
@@ -15,86 +15,81 @@
 #ifndef FRONTEND_FBANK_H_
 #define FRONTEND_FBANK_H_
 
+#include <cmath>
 #include <cstring>
 #include <limits>
-#include <random>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "frontend/fbank_tables.h"
+#include "frontend/feature_matrix.h"
 #include "frontend/fft.h"
+#include "frontend/frame_preprocess.h"
+#include "frontend/mel_banks.h"
 #include "utils/log.h"
 
 namespace wenet {
 
+// Interface of the fbank extractors, implemented by the runtime configured
+// Fbank and by FixedFbank (frontend/fixed_fbank.h) which is specialized at
+// compile time for the standard configurations.
+class FbankBase {
+ public:
+  virtual ~FbankBase() {}
+
+  virtual int num_bins() const = 0;
+  virtual int frame_length() const = 0;
+  virtual int frame_shift() const = 0;
+
+  // Compute fbank feat of every complete frame of wave[0, num_samples) and
+  // append them as rows of feat, return num frames. The frames are read in
+  // place, the caller drops num_frames * frame_shift samples of wave
+  // afterwards. An empty feat gets num_bins() columns. The log energy of
+  // each frame's power spectrum is appended to log_energy if not null.
+  virtual int Compute(const float* wave, int num_samples, FeatureMatrix* feat,
+                      std::vector<float>* log_energy = nullptr) = 0;
+
+ protected:
+  // Append num_frames rows to feat, return the first of them.
+  float* AppendFrames(int num_frames, FeatureMatrix* feat) const {
+    if (feat->empty()) feat->Resize(0, num_bins());
+    CHECK(feat->num_cols() == num_bins());
+    return feat->AppendRows(num_frames);
+  }
+
+  // Append the log energies of num_frames power spectrum rows.
+  static void AppendLogEnergy(const float* power, int num_fft_bins,
+                              int num_frames, std::vector<float>* log_energy) {
+    if (log_energy == nullptr) return;
+    size_t offset = log_energy->size();
+    log_energy->resize(offset + num_frames);
+    LogEnergy(power, num_fft_bins, num_fft_bins, num_frames,
+              log_energy->data() + offset);
+  }
+};
+
 // This code is based on kaldi Fbank implentation, please see
 // https://github.com/kaldi-asr/kaldi/blob/master/src/feat/feature-fbank.cc
-class Fbank {
+class Fbank : public FbankBase {
  public:
   Fbank(int num_bins, int sample_rate, int frame_length, int frame_shift)
-      : num_bins_(num_bins),
-        sample_rate_(sample_rate),
-        frame_length_(frame_length),
+      : Fbank(FbankTables::Get(num_bins, sample_rate, frame_length),
+              frame_shift) {}
+
+  // Use tables shared with other Fbank instances, the per instance state is
+  // only the dither generator and the scratch buffers.
+  Fbank(std::shared_ptr<const FbankTables> tables, int frame_shift)
+      : tables_(std::move(tables)),
+        num_bins_(tables_->num_bins()),
+        frame_length_(tables_->frame_length()),
         frame_shift_(frame_shift),
+        fft_points_(tables_->fft_points()),
         use_log_(true),
         remove_dc_offset_(true),
-        generator_(0),
-        distribution_(0, 1.0),
         dither_(0.0) {
-    fft_points_ = UpperPowerOfTwo(frame_length_);
-    // generate bit reversal table and trigonometric function table
-    const int fft_points_4 = fft_points_ / 4;
-    bitrev_.resize(fft_points_);
-    sintbl_.resize(fft_points_ + fft_points_4);
-    make_sintbl(fft_points_, sintbl_.data());
-    make_bitrev(fft_points_, bitrev_.data());
-
-    int num_fft_bins = fft_points_ / 2;
-    float fft_bin_width = static_cast<float>(sample_rate_) / fft_points_;
-    int low_freq = 20, high_freq = sample_rate_ / 2;
-    float mel_low_freq = MelScale(low_freq);
-    float mel_high_freq = MelScale(high_freq);
-    float mel_freq_delta = (mel_high_freq - mel_low_freq) / (num_bins + 1);
-    bins_.resize(num_bins_);
-    center_freqs_.resize(num_bins_);
-    //计算left_mel 是当前滤波器左边界的梅尔频率。center_mel 是当前滤波器中心的梅尔频率。 right_mel 是当前滤波器右边界的梅尔频率。
-    for (int bin = 0; bin < num_bins; ++bin) {
-      float left_mel = mel_low_freq + bin * mel_freq_delta,
-            center_mel = mel_low_freq + (bin + 1) * mel_freq_delta,
-            right_mel = mel_low_freq + (bin + 2) * mel_freq_delta;
-      center_freqs_[bin] = InverseMelScale(center_mel);
-      std::vector<float> this_bin(num_fft_bins);
-      int first_index = -1, last_index = -1;
-      for (int i = 0; i < num_fft_bins; ++i) {
-        float freq = (fft_bin_width * i);  // Center frequency of this fft
-        // bin.
-        float mel = MelScale(freq);
-        if (mel > left_mel && mel < right_mel) {
-          float weight;
-          if (mel <= center_mel)
-            weight = (mel - left_mel) / (center_mel - left_mel);
-          else
-            weight = (right_mel - mel) / (right_mel - center_mel);
-          this_bin[i] = weight;
-          if (first_index == -1) first_index = i;
-          last_index = i;
-        }
-      }
-      CHECK(first_index != -1 && last_index >= first_index);
-      bins_[bin].first = first_index;
-      int size = last_index + 1 - first_index;
-      bins_[bin].second.resize(size);
-      for (int i = 0; i < size; ++i) {
-        bins_[bin].second[i] = this_bin[first_index + i];
-      }
-    }
-
-    // NOTE(cdliang): add hamming window
-    hamming_window_.resize(frame_length_);
-    double a = M_2PI / (frame_length - 1);
-    for (int i = 0; i < frame_length; i++) {
-      double i_fl = static_cast<double>(i);
-      hamming_window_[i] = 0.54 - 0.46 * cos(a * i_fl);
-    }
+    fft_real_.resize(fft_points_, 0.0f);
+    fft_img_.resize(fft_points_ / 2);
   }
 
   void set_use_log(bool use_log) { use_log_ = use_log; }
@@ -105,117 +100,73 @@ class Fbank {
 
   void set_dither(float dither) { dither_ = dither; }
 
-  int num_bins() const { return num_bins_; }
+  int num_bins() const override { return num_bins_; }
+  int frame_length() const override { return frame_length_; }
+  int frame_shift() const override { return frame_shift_; }
+
+  const FbankTables& tables() const { return *tables_; }
 
   static inline float InverseMelScale(float mel_freq) {
-    return 700.0f * (expf(mel_freq / 1127.0f) - 1.0f);
+    return FbankTables::InverseMelScale(mel_freq);
   }
 
   static inline float MelScale(float freq) {
-    return 1127.0f * logf(1.0f + freq / 700.0f);
+    return FbankTables::MelScale(freq);
   }
 
   static int UpperPowerOfTwo(int n) {
-    return static_cast<int>(pow(2, ceil(log(n) / log(2))));
-  }
-
-  // preemphasis
-  void PreEmphasis(float coeff, std::vector<float>* data) const {
-    if (coeff == 0.0) return;
-    for (int i = data->size() - 1; i > 0; i--)
-      (*data)[i] -= coeff * (*data)[i - 1];
-    (*data)[0] -= coeff * (*data)[0];
+    return FbankTables::UpperPowerOfTwo(n);
   }
 
-  // add hamming window
-  void Hamming(std::vector<float>* data) const {
-    CHECK(data->size() >= hamming_window_.size());
-    for (size_t i = 0; i < hamming_window_.size(); ++i) {
-      (*data)[i] *= hamming_window_[i];
-    }
+  // Compute fbank feat, return num frames
+  int Compute(const std::vector<float>& wave, FeatureMatrix* feat) {
+    feat->Clear();
+    return Compute(wave.data(), wave.size(), feat);
   }
 
-  // Compute fbank feat, return num frames
-  int Compute(const std::vector<float>& wave,
-              std::vector<std::vector<float>>* feat) {
-    int num_samples = wave.size();
+  int Compute(const float* wave, int num_samples, FeatureMatrix* feat,
+              std::vector<float>* log_energy = nullptr) override {
     if (num_samples < frame_length_) return 0;
     int num_frames = 1 + ((num_samples - frame_length_) / frame_shift_);
-    feat->resize(num_frames);
-    std::vector<float> fft_real(fft_points_, 0), fft_img(fft_points_, 0);
-    std::vector<float> power(fft_points_ / 2);
+    const int num_fft_bins = fft_points_ / 2;
+    power_.resize(num_frames * num_fft_bins);
     for (int i = 0; i < num_frames; ++i) {
-      std::vector<float> data(wave.data() + i * frame_shift_,
-                              wave.data() + i * frame_shift_ + frame_length_);
-      // optional add noise
-      if (dither_ != 0.0) {
-        for (size_t j = 0; j < data.size(); ++j)
-          data[j] += dither_ * distribution_(generator_);
-      }
-      // optinal remove dc offset
-      if (remove_dc_offset_) {
-        float mean = 0.0;
-        for (size_t j = 0; j < data.size(); ++j) mean += data[j];
-        mean /= data.size();
-        for (size_t j = 0; j < data.size(); ++j) data[j] -= mean;
-      }
-
-      PreEmphasis(0.97, &data);
-      // Povey(&data);
-      Hamming(&data);
-      // copy data to fft_real
-      memset(fft_img.data(), 0, sizeof(float) * fft_points_);
-      memset(fft_real.data() + frame_length_, 0,
-             sizeof(float) * (fft_points_ - frame_length_));
-      memcpy(fft_real.data(), data.data(), sizeof(float) * frame_length_);
-      fft(bitrev_.data(), sintbl_.data(), fft_real.data(), fft_img.data(),
-          fft_points_);
+      // optional add noise, optinal remove dc offset, preemphasis and
+      // hamming window in one fused kernel, written to fft_real. The zero
+      // padding tail of fft_real is never written.
+      PreprocessFrame(wave + i * frame_shift_, frame_length_, dither_, &rng_,
+                      remove_dc_offset_, 0.97,
+                      tables_->hamming_window().data(), fft_real_.data());
       // power
-      for (int j = 0; j < fft_points_ / 2; ++j) {
-        power[j] = fft_real[j] * fft_real[j] + fft_img[j] * fft_img[j];
-      }
-
-      (*feat)[i].resize(num_bins_);
-      // cepstral coefficients, triangle filter array
-      for (int j = 0; j < num_bins_; ++j) {
-        float mel_energy = 0.0;
-        int s = bins_[j].first;
-        for (size_t k = 0; k < bins_[j].second.size(); ++k) {
-          mel_energy += bins_[j].second[k] * power[s + k];
-        }
-        // optional use log
-        if (use_log_) {
-          if (mel_energy < std::numeric_limits<float>::epsilon())
-            mel_energy = std::numeric_limits<float>::epsilon();
-          mel_energy = logf(mel_energy);
-        }
-
-        (*feat)[i][j] = mel_energy;
-        // printf("%f ", mel_energy);
-      }
-      // printf("\n");
+      rfft_power(tables_->bitrev().data(), tables_->sintbl().data(),
+                 tables_->rsintbl().data(), fft_real_.data(), fft_img_.data(),
+                 power_.data() + i * num_fft_bins, fft_points_);
     }
+
+    // cepstral coefficients, triangle filter array, all frames at once,
+    // optional use log, written straight to the rows of feat
+    tables_->mel_banks().Compute(power_.data(), num_fft_bins, num_frames,
+                                 use_log_, AppendFrames(num_frames, feat),
+                                 num_bins_);
+    AppendLogEnergy(power_.data(), num_fft_bins, num_frames, log_energy);
     return num_frames;
   }
 
  private:
+  std::shared_ptr<const FbankTables> tables_;
   int num_bins_;
-  int sample_rate_;
   int frame_length_, frame_shift_;
   int fft_points_;
   bool use_log_;
   bool remove_dc_offset_;
-  std::vector<float> center_freqs_;
-  std::vector<std::pair<int, std::vector<float>>> bins_;
-  std::vector<float> hamming_window_;
-  std::default_random_engine generator_;
-  std::normal_distribution<float> distribution_;
+  DitherRng rng_;
   float dither_;
 
-  // bit reversal table
-  std::vector<int> bitrev_;
-  // trigonometric function table
-  std::vector<float> sintbl_;
+  // per frame scratch, allocated once
+  std::vector<float> fft_real_;
+  std::vector<float> fft_img_;
+  // power spectrum of the frames in one Compute() call
+  AlignedVector<float> power_;
 };
 
 }  // namespace wenet
@@ -0,0 +1,134 @@
+// Copyright (c) 2017 Personal (Binbin Zhang)
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/fbank_tables.h"
+
+#include <math.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include "frontend/fft.h"
+#include "utils/log.h"
+
+namespace wenet {
+
+FbankTables::FbankTables(int num_bins, int sample_rate, int frame_length)
+    : num_bins_(num_bins),
+      sample_rate_(sample_rate),
+      frame_length_(frame_length) {
+  fft_points_ = UpperPowerOfTwo(frame_length_);
+  // generate bit reversal table and trigonometric function table, the real
+  // input fft runs a complex fft of fft_points_ / 2 points
+  const int fft_points_2 = fft_points_ / 2;
+  bitrev_.resize(fft_points_2);
+  sintbl_.resize(fft_points_2 + fft_points_2 / 4);
+  make_sintbl(fft_points_2, sintbl_.data());
+  make_bitrev(fft_points_2, bitrev_.data());
+  rsintbl_.resize(fft_points_ + fft_points_ / 4);
+  make_sintbl(fft_points_, rsintbl_.data());
+
+  int num_fft_bins = fft_points_ / 2;
+  float fft_bin_width = static_cast<float>(sample_rate_) / fft_points_;
+  int low_freq = 20, high_freq = sample_rate_ / 2;
+  float mel_low_freq = MelScale(low_freq);
+  float mel_high_freq = MelScale(high_freq);
+  float mel_freq_delta = (mel_high_freq - mel_low_freq) / (num_bins + 1);
+  std::vector<std::pair<int, std::vector<float>>> bins(num_bins_);
+  center_freqs_.resize(num_bins_);
+  // mel scale of the center frequency of every fft bin
+  std::vector<float> fft_mel(num_fft_bins);
+  for (int i = 0; i < num_fft_bins; ++i) {
+    fft_mel[i] = MelScale(fft_bin_width * i);
+  }
+  //计算left_mel 是当前滤波器左边界的梅尔频率。center_mel 是当前滤波器中心的梅尔频率。 right_mel 是当前滤波器右边界的梅尔频率。
+  for (int bin = 0; bin < num_bins; ++bin) {
+    float left_mel = mel_low_freq + bin * mel_freq_delta,
+          center_mel = mel_low_freq + (bin + 1) * mel_freq_delta,
+          right_mel = mel_low_freq + (bin + 2) * mel_freq_delta;
+    center_freqs_[bin] = InverseMelScale(center_mel);
+    int first_index = -1, last_index = -1;
+    for (int i = 0; i < num_fft_bins; ++i) {
+      if (fft_mel[i] > left_mel && fft_mel[i] < right_mel) {
+        if (first_index == -1) first_index = i;
+        last_index = i;
+      }
+    }
+    CHECK(first_index != -1 && last_index >= first_index);
+    bins[bin].first = first_index;
+    int size = last_index + 1 - first_index;
+    bins[bin].second.resize(size);
+    for (int i = 0; i < size; ++i) {
+      float mel = fft_mel[first_index + i];
+      if (mel <= center_mel)
+        bins[bin].second[i] = (mel - left_mel) / (center_mel - left_mel);
+      else
+        bins[bin].second[i] = (right_mel - mel) / (right_mel - center_mel);
+    }
+  }
+  mel_banks_.reset(new MelBanks(bins, num_fft_bins));
+
+  // NOTE(cdliang): add hamming window
+  hamming_window_.resize(frame_length_);
+  double a = M_2PI / (frame_length - 1);
+  for (int i = 0; i < frame_length; i++) {
+    double i_fl = static_cast<double>(i);
+    hamming_window_[i] = 0.54 - 0.46 * cos(a * i_fl);
+  }
+}
+
+std::shared_ptr<const FbankTables> FbankTables::Get(int num_bins,
+                                                    int sample_rate,
+                                                    int frame_length) {
+  typedef std::tuple<int, int, int> Key;
+  // configurations cached before the unused ones are dropped
+  const size_t kMaxCached = 4;
+  static std::mutex mutex;
+  static std::map<Key, std::shared_ptr<const FbankTables>> cache;
+  std::lock_guard<std::mutex> lock(mutex);
+  const Key key(num_bins, sample_rate, frame_length);
+  auto it = cache.find(key);
+  if (it != cache.end()) return it->second;
+  if (cache.size() >= kMaxCached) {
+    // only the cache holds the unused ones
+    for (auto entry = cache.begin(); entry != cache.end();) {
+      if (entry->second.use_count() == 1) {
+        entry = cache.erase(entry);
+      } else {
+        ++entry;
+      }
+    }
+  }
+  std::shared_ptr<const FbankTables> tables =
+      std::make_shared<const FbankTables>(num_bins, sample_rate, frame_length);
+  cache.emplace(key, tables);
+  return tables;
+}
+
+float FbankTables::InverseMelScale(float mel_freq) {
+  return 700.0f * (expf(mel_freq / 1127.0f) - 1.0f);
+}
+
+float FbankTables::MelScale(float freq) {
+  return 1127.0f * logf(1.0f + freq / 700.0f);
+}
+
+int FbankTables::UpperPowerOfTwo(int n) {
+  return static_cast<int>(pow(2, ceil(log(n) / log(2))));
+}
+
+}  // namespace wenet
@@ -0,0 +1,74 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_FBANK_TABLES_H_
+#define FRONTEND_FBANK_TABLES_H_
+
+#include <memory>
+#include <vector>
+
+#include "frontend/mel_banks.h"
+
+namespace wenet {
+
+// Immutable tables of an Fbank configuration: fft tables, hamming window and
+// mel filterbank. They only depend on (num_bins, sample_rate, frame_length),
+// are built once per configuration and shared by every Fbank through Get(),
+// so creating a pipeline does not rebuild them.
+class FbankTables {
+ public:
+  FbankTables(int num_bins, int sample_rate, int frame_length);
+
+  // Shared tables of a configuration. The cache keeps them after the last
+  // Fbank using them is gone, so pipelines created one after another do not
+  // rebuild them. Unused tables are dropped once more than a few
+  // configurations are cached. Thread safe.
+  static std::shared_ptr<const FbankTables> Get(int num_bins, int sample_rate,
+                                                int frame_length);
+
+  static float InverseMelScale(float mel_freq);
+  static float MelScale(float freq);
+  static int UpperPowerOfTwo(int n);
+
+  int num_bins() const { return num_bins_; }
+  int sample_rate() const { return sample_rate_; }
+  int frame_length() const { return frame_length_; }
+  int fft_points() const { return fft_points_; }
+
+  // bit reversal table of the complex fft of fft_points / 2 points
+  const std::vector<int>& bitrev() const { return bitrev_; }
+  // trigonometric function table of the complex fft
+  const std::vector<float>& sintbl() const { return sintbl_; }
+  // trigonometric function table for the real fft post-twiddle
+  const std::vector<float>& rsintbl() const { return rsintbl_; }
+  const std::vector<float>& hamming_window() const { return hamming_window_; }
+  const std::vector<float>& center_freqs() const { return center_freqs_; }
+  const MelBanks& mel_banks() const { return *mel_banks_; }
+
+ private:
+  int num_bins_;
+  int sample_rate_;
+  int frame_length_;
+  int fft_points_;
+  std::vector<int> bitrev_;
+  std::vector<float> sintbl_;
+  std::vector<float> rsintbl_;
+  std::vector<float> hamming_window_;
+  std::vector<float> center_freqs_;
+  std::unique_ptr<MelBanks> mel_banks_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_FBANK_TABLES_H_
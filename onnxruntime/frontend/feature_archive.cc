@@ -0,0 +1,322 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/feature_archive.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "utils/log.h"
+
+namespace wenet {
+
+namespace {
+
+const char kMagic[8] = {'W', 'K', 'W', 'S', 'F', 'E', 'A', 'T'};
+// 2 adds the pipeline config to the header
+const uint32_t kVersion = 2;
+const int kNumConfigFields = 7;
+// magic, version, num_entries, index offset, config
+const size_t kHeaderSize = 8 + 4 + 4 + 8 + 4 * kNumConfigFields;
+
+template <typename T>
+T ReadField(const char** p) {
+  T v;
+  memcpy(&v, *p, sizeof(v));
+  *p += sizeof(v);
+  return v;
+}
+
+// Bytes of the matrix of an entry.
+uint64_t MatrixSize(int32_t rows, int32_t cols, bool compressed) {
+  uint64_t n = static_cast<uint64_t>(rows) * cols;
+  return compressed ? 2 * sizeof(float) * cols + n : sizeof(float) * n;
+}
+
+// The config fields in header order, const or not as the config.
+template <typename Config, typename Field>
+void ConfigFields(Config* config, Field* fields[kNumConfigFields]) {
+  fields[0] = &config->num_bins;
+  fields[1] = &config->model_type;
+  fields[2] = &config->sample_rate;
+  fields[3] = &config->frame_shift;
+  fields[4] = &config->left_context;
+  fields[5] = &config->right_context;
+  fields[6] = &config->downsampling;
+}
+
+}  // namespace
+
+FeatureArchiveConfig::FeatureArchiveConfig(const FeaturePipelineConfig& config)
+    : num_bins(config.num_bins),
+      model_type(config.model_type),
+      sample_rate(config.sample_rate),
+      frame_shift(config.frame_shift) {
+  // only the ctc features are spliced and downsampled
+  if (config.model_type == CTC_TYPE_MODEL) {
+    left_context = config.left_context;
+    right_context = config.right_context;
+    downsampling = config.downsampling;
+  } else {
+    downsampling = 1;
+  }
+}
+
+bool FeatureArchiveConfig::operator==(const FeatureArchiveConfig& other) const {
+  const int32_t* a[kNumConfigFields];
+  const int32_t* b[kNumConfigFields];
+  ConfigFields(this, a);
+  ConfigFields(&other, b);
+  for (int i = 0; i < kNumConfigFields; ++i) {
+    if (*a[i] != *b[i]) return false;
+  }
+  return true;
+}
+
+std::string FeatureArchiveConfig::ToString() const {
+  std::ostringstream ss;
+  ss << "num_bins " << num_bins << " model_type " << model_type
+     << " sample_rate " << sample_rate << " frame_shift " << frame_shift
+     << " context " << left_context << "/" << right_context
+     << " downsampling " << downsampling;
+  return ss.str();
+}
+
+bool FeatureArchiveWriter::Open(const std::string& filename,
+                                const FeatureArchiveConfig& config,
+                                bool compress) {
+  Close();
+  fp_ = fopen(filename.c_str(), "wb");
+  if (fp_ == nullptr) {
+    LOG(WARNING) << "Error in write " << filename;
+    return false;
+  }
+  config_ = config;
+  compress_ = compress;
+  entries_.clear();
+  offset_ = 0;
+  // the header is rewritten by Close() once the index offset is known
+  std::vector<char> header(kHeaderSize, 0);
+  return WriteBytes(header.data(), header.size());
+}
+
+bool FeatureArchiveWriter::WriteBytes(const void* data, size_t size) {
+  if (size > 0 && fwrite(data, 1, size, fp_) != size) {
+    LOG(WARNING) << "Error in write feature archive";
+    return false;
+  }
+  offset_ += size;
+  return true;
+}
+
+bool FeatureArchiveWriter::Write(const std::string& key,
+                                 const FeatureView& feats) {
+  CHECK(fp_ != nullptr);
+  static const char zeros[kSimdAlignment] = {0};
+  if (!WriteBytes(zeros, (kSimdAlignment - offset_ % kSimdAlignment) %
+                             kSimdAlignment)) {
+    return false;
+  }
+  const int rows = feats.num_rows(), cols = feats.num_cols();
+  entries_.push_back(Entry{key, offset_, rows, cols, compress_ ? 1u : 0u});
+  if (!compress_) {
+    return WriteBytes(feats.data(), sizeof(float) * feats.size());
+  }
+  // per column min and step, [min, max] is mapped to [0, 255]
+  column_params_.assign(2 * cols, 0.0f);
+  float* min = column_params_.data();
+  float* step = min + cols;
+  if (rows > 0) {
+    // step holds the max until the last row is seen
+    memcpy(min, feats.Row(0), sizeof(float) * cols);
+    memcpy(step, feats.Row(0), sizeof(float) * cols);
+  }
+  for (int r = 1; r < rows; ++r) {
+    const float* row = feats.Row(r);
+    for (int c = 0; c < cols; ++c) {
+      min[c] = std::min(min[c], row[c]);
+      step[c] = std::max(step[c], row[c]);
+    }
+  }
+  for (int c = 0; c < cols; ++c) {
+    step[c] = step[c] > min[c] ? (step[c] - min[c]) / 255.0f : 1.0f;
+  }
+  quantized_.resize(feats.size());
+  for (int r = 0; r < rows; ++r) {
+    const float* row = feats.Row(r);
+    uint8_t* q = quantized_.data() + r * cols;
+    for (int c = 0; c < cols; ++c) {
+      float v = (row[c] - min[c]) / step[c];
+      q[c] = static_cast<uint8_t>(std::min(std::max(lrintf(v), 0L), 255L));
+    }
+  }
+  return WriteBytes(column_params_.data(),
+                    sizeof(float) * column_params_.size()) &&
+         WriteBytes(quantized_.data(), quantized_.size());
+}
+
+bool FeatureArchiveWriter::Close() {
+  if (fp_ == nullptr) return true;
+  uint64_t index_offset = offset_;
+  bool ok = true;
+  for (const Entry& entry : entries_) {
+    uint32_t key_size = entry.key.size();
+    ok = ok && WriteBytes(&key_size, sizeof(key_size)) &&
+         WriteBytes(entry.key.data(), key_size) &&
+         WriteBytes(&entry.offset, sizeof(entry.offset)) &&
+         WriteBytes(&entry.rows, sizeof(entry.rows)) &&
+         WriteBytes(&entry.cols, sizeof(entry.cols)) &&
+         WriteBytes(&entry.compressed, sizeof(entry.compressed));
+  }
+  uint32_t num_entries = entries_.size();
+  ok = ok && fseek(fp_, 0, SEEK_SET) == 0 && WriteBytes(kMagic, 8) &&
+       WriteBytes(&kVersion, sizeof(kVersion)) &&
+       WriteBytes(&num_entries, sizeof(num_entries)) &&
+       WriteBytes(&index_offset, sizeof(index_offset));
+  const int32_t* fields[kNumConfigFields];
+  ConfigFields(&config_, fields);
+  for (int i = 0; i < kNumConfigFields; ++i) {
+    ok = ok && WriteBytes(fields[i], sizeof(int32_t));
+  }
+  ok = fclose(fp_) == 0 && ok;
+  fp_ = nullptr;
+  entries_.clear();
+  return ok;
+}
+
+bool FeatureArchiveReader::Open(const std::string& filename) {
+  config_ = FeatureArchiveConfig();
+  keys_.clear();
+  index_.clear();
+  if (!file_.Open(filename)) {
+    LOG(WARNING) << "Error in read " << filename;
+    return false;
+  }
+  const char* data = file_.data();
+  const size_t size = file_.size();
+  if (size < kHeaderSize || memcmp(data, kMagic, 8) != 0) {
+    LOG(WARNING) << filename << " is not a feature archive";
+    return false;
+  }
+  const char* p = data + 8;
+  uint32_t version = ReadField<uint32_t>(&p);
+  uint32_t num_entries = ReadField<uint32_t>(&p);
+  uint64_t index_offset = ReadField<uint64_t>(&p);
+  if (version != kVersion) {
+    LOG(WARNING) << filename << ": feature archive version " << version
+                 << ", expected " << kVersion << ", recompute it";
+    return false;
+  }
+  if (index_offset > size) {
+    LOG(WARNING) << filename << ": bad feature archive header";
+    return false;
+  }
+  int32_t* fields[kNumConfigFields];
+  ConfigFields(&config_, fields);
+  for (int i = 0; i < kNumConfigFields; ++i) {
+    *fields[i] = ReadField<int32_t>(&p);
+  }
+  p = data + index_offset;
+  const char* end = data + size;
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    if (end - p < 4) break;
+    uint32_t key_size = ReadField<uint32_t>(&p);
+    if (static_cast<size_t>(end - p) < key_size + 20) break;
+    std::string key(p, key_size);
+    p += key_size;
+    Entry entry;
+    entry.offset = ReadField<uint64_t>(&p);
+    entry.rows = ReadField<int32_t>(&p);
+    entry.cols = ReadField<int32_t>(&p);
+    entry.compressed = ReadField<uint32_t>(&p) != 0;
+    if (entry.rows < 0 || entry.cols < 0 || entry.offset > index_offset ||
+        MatrixSize(entry.rows, entry.cols, entry.compressed) >
+            index_offset - entry.offset) {
+      break;
+    }
+    keys_.push_back(key);
+    index_[key] = entry;
+  }
+  if (keys_.size() != num_entries) {
+    LOG(WARNING) << filename << ": bad feature archive index";
+    keys_.clear();
+    index_.clear();
+    return false;
+  }
+  return true;
+}
+
+bool FeatureArchiveReader::Open(const std::string& filename,
+                               const FeatureArchiveConfig& expected) {
+  if (!Open(filename)) return false;
+  if (config_ != expected) {
+    LOG(WARNING) << filename << ": features of " << config_.ToString()
+                 << ", the pipeline has " << expected.ToString();
+    keys_.clear();
+    index_.clear();
+    return false;
+  }
+  return true;
+}
+
+const FeatureArchiveReader::Entry* FeatureArchiveReader::Find(
+    const std::string& key) const {
+  auto it = index_.find(key);
+  return it == index_.end() ? nullptr : &it->second;
+}
+
+bool FeatureArchiveReader::View(const std::string& key,
+                                FeatureView* feats) const {
+  const Entry* entry = Find(key);
+  if (entry == nullptr || entry->compressed) return false;
+  *feats = FeatureView(
+      reinterpret_cast<const float*>(file_.data() + entry->offset),
+      entry->rows, entry->cols);
+  return true;
+}
+
+bool FeatureArchiveReader::Read(const std::string& key,
+                                FeatureMatrix* feats) const {
+  const Entry* entry = Find(key);
+  if (entry == nullptr) return false;
+  const char* data = file_.data() + entry->offset;
+  const int rows = entry->rows, cols = entry->cols;
+  feats->Resize(rows, cols);
+  if (!entry->compressed) {
+    memcpy(feats->data(), data, sizeof(float) * feats->size());
+    return true;
+  }
+  const float* min = reinterpret_cast<const float*>(data);
+  const float* step = min + cols;
+  const uint8_t* q = reinterpret_cast<const uint8_t*>(step + cols);
+  for (int r = 0; r < rows; ++r) {
+    float* row = feats->Row(r);
+    const uint8_t* qr = q + r * cols;
+    for (int c = 0; c < cols; ++c) row[c] = min[c] + step[c] * qr[c];
+  }
+  return true;
+}
+
+bool FeatureArchiveReader::Get(const std::string& key, FeatureMatrix* buffer,
+                               FeatureView* feats) const {
+  if (View(key, feats)) return true;
+  if (!Read(key, buffer)) return false;
+  *feats = *buffer;
+  return true;
+}
+
+}  // namespace wenet
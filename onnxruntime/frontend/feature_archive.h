@@ -0,0 +1,156 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_FEATURE_ARCHIVE_H_
+#define FRONTEND_FEATURE_ARCHIVE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frontend/feature_matrix.h"
+#include "frontend/feature_pipeline.h"
+#include "utils/mapped_file.h"
+
+namespace wenet {
+
+// Binary archive of the features of many utterances, to compute them once
+// and reuse them across experiments. The layout is made to be memory
+// mapped, all fields are little endian:
+//
+//   header   "WKWSFEAT", uint32 version, uint32 num_entries,
+//            uint64 offset of the index, FeatureArchiveConfig as 7 int32
+//   matrices one per entry, each at an offset aligned to kSimdAlignment
+//   index    per entry: uint32 key size, key, uint64 offset, int32 rows,
+//            int32 cols, uint32 compressed
+//
+// A plain matrix is rows x cols floats, so it is read in place. A
+// compressed one, like Kaldi's compressed matrix, stores cols float mins,
+// cols float steps, then rows x cols uint8, value = min[c] + step[c] * q,
+// about 4 times smaller for an error of half a step.
+
+// Pipeline settings the features were computed with. A reader checks them
+// against its own pipeline, features of another frontend are rejected.
+struct FeatureArchiveConfig {
+  int32_t num_bins = 0;
+  int32_t model_type = 0;
+  int32_t sample_rate = 0;
+  int32_t frame_shift = 0;
+  int32_t left_context = 0;
+  int32_t right_context = 0;
+  int32_t downsampling = 0;
+
+  FeatureArchiveConfig() {}
+  explicit FeatureArchiveConfig(const FeaturePipelineConfig& config);
+
+  bool operator==(const FeatureArchiveConfig& other) const;
+  bool operator!=(const FeatureArchiveConfig& other) const {
+    return !(*this == other);
+  }
+
+  std::string ToString() const;
+};
+
+class FeatureArchiveWriter {
+ public:
+  FeatureArchiveWriter() : fp_(nullptr), offset_(0) {}
+  ~FeatureArchiveWriter() { Close(); }
+
+  FeatureArchiveWriter(const FeatureArchiveWriter&) = delete;
+  FeatureArchiveWriter& operator=(const FeatureArchiveWriter&) = delete;
+
+  bool Open(const std::string& filename, const FeatureArchiveConfig& config,
+            bool compress = false);
+
+  // Append the features of utterance key.
+  bool Write(const std::string& key, const FeatureView& feats);
+
+  // Write the index, the archive is not readable before.
+  bool Close();
+
+ private:
+  struct Entry {
+    std::string key;
+    uint64_t offset;
+    int32_t rows;
+    int32_t cols;
+    uint32_t compressed;
+  };
+
+  bool WriteBytes(const void* data, size_t size);
+
+  FILE* fp_;
+  FeatureArchiveConfig config_;
+  bool compress_;
+  uint64_t offset_;
+  std::vector<Entry> entries_;
+  std::vector<float> column_params_;
+  std::vector<uint8_t> quantized_;
+};
+
+class FeatureArchiveReader {
+ public:
+  FeatureArchiveReader() {}
+  explicit FeatureArchiveReader(const std::string& filename) {
+    Open(filename);
+  }
+
+  // Map the archive and load its index.
+  bool Open(const std::string& filename);
+
+  // Open() an archive written with the expected config, fail on another.
+  bool Open(const std::string& filename, const FeatureArchiveConfig& expected);
+
+  const FeatureArchiveConfig& config() const { return config_; }
+
+  // Keys in writing order.
+  const std::vector<std::string>& keys() const { return keys_; }
+
+  bool Contains(const std::string& key) const {
+    return index_.count(key) > 0;
+  }
+
+  // Zero-copy view of the features of key, valid while the reader is open.
+  // Return false if there is no such key or if it is compressed.
+  bool View(const std::string& key, FeatureView* feats) const;
+
+  // Features of key, a copy of a plain matrix or a decompressed one.
+  bool Read(const std::string& key, FeatureMatrix* feats) const;
+
+  // View() when the entry is plain, else Read() into buffer. feats stays
+  // valid while the reader and buffer are.
+  bool Get(const std::string& key, FeatureMatrix* buffer,
+           FeatureView* feats) const;
+
+ private:
+  struct Entry {
+    uint64_t offset;
+    int32_t rows;
+    int32_t cols;
+    bool compressed;
+  };
+
+  const Entry* Find(const std::string& key) const;
+
+  MappedFile file_;
+  FeatureArchiveConfig config_;
+  std::vector<std::string> keys_;
+  std::unordered_map<std::string, Entry> index_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_FEATURE_ARCHIVE_H_
@@ -0,0 +1,188 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_FEATURE_MATRIX_H_
+#define FRONTEND_FEATURE_MATRIX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "utils/aligned_allocator.h"
+#include "utils/log.h"
+
+namespace wenet {
+
+// Row-major num_rows x num_cols float matrix in one aligned buffer, one row
+// per feature frame. Frames are written once into their row, and the whole
+// matrix can be handed to onnxruntime as a tensor buffer.
+class FeatureMatrix {
+ public:
+  FeatureMatrix() : num_rows_(0), num_cols_(0) {}
+  FeatureMatrix(int num_rows, int num_cols) { Resize(num_rows, num_cols); }
+
+  int num_rows() const { return num_rows_; }
+  int num_cols() const { return num_cols_; }
+  int size() const { return num_rows_ * num_cols_; }
+  bool empty() const { return num_rows_ == 0; }
+
+  float* data() { return data_.data(); }
+  const float* data() const { return data_.data(); }
+  float* Row(int i) { return data_.data() + i * num_cols_; }
+  const float* Row(int i) const { return data_.data() + i * num_cols_; }
+
+  // The content is kept when num_cols does not change, new rows are zero.
+  void Resize(int num_rows, int num_cols) {
+    num_rows_ = num_rows;
+    num_cols_ = num_cols;
+    data_.resize(num_rows * num_cols, 0.0f);
+  }
+
+  // Append n rows to be written by the caller, return the first of them.
+  float* AppendRows(int n) {
+    int offset = size();
+    num_rows_ += n;
+    data_.resize(offset + n * num_cols_);
+    return data_.data() + offset;
+  }
+
+  // Append n rows of num_cols() floats.
+  void AppendRows(const float* rows, int n) {
+    if (n > 0) memcpy(AppendRows(n), rows, sizeof(float) * n * num_cols_);
+  }
+
+  // Drop every row, the capacity and num_cols() are kept.
+  void Clear() {
+    num_rows_ = 0;
+    data_.clear();
+  }
+
+ private:
+  int num_rows_;
+  int num_cols_;
+  AlignedVector<float> data_;
+};
+
+// Non owning view of contiguous row-major features, e.g. a FeatureMatrix or
+// a range of its rows.
+class FeatureView {
+ public:
+  FeatureView() : data_(nullptr), num_rows_(0), num_cols_(0) {}
+  FeatureView(const float* data, int num_rows, int num_cols)
+      : data_(data), num_rows_(num_rows), num_cols_(num_cols) {}
+  FeatureView(const FeatureMatrix& matrix)  // NOLINT
+      : data_(matrix.data()),
+        num_rows_(matrix.num_rows()),
+        num_cols_(matrix.num_cols()) {}
+
+  int num_rows() const { return num_rows_; }
+  int num_cols() const { return num_cols_; }
+  int size() const { return num_rows_ * num_cols_; }
+  bool empty() const { return num_rows_ == 0; }
+  const float* data() const { return data_; }
+  const float* Row(int i) const { return data_ + i * num_cols_; }
+
+  // Rows [begin, begin + n).
+  FeatureView Rows(int begin, int n) const {
+    return FeatureView(Row(begin), n, num_cols_);
+  }
+
+ private:
+  const float* data_;
+  int num_rows_;
+  int num_cols_;
+};
+
+// First in first out queue of feature rows, stored contiguously, with a
+// speech flag per row set by the vad (1 when there is no vad). Popped rows
+// are dropped lazily, the queued rows are moved to the front once there are
+// no more of them than of popped ones, so every row is moved O(1) times on
+// average. Not thread safe.
+class FeatureFifo {
+ public:
+  explicit FeatureFifo(int num_cols) : head_(0) { rows_.Resize(0, num_cols); }
+
+  int num_cols() const { return rows_.num_cols(); }
+
+  // Number of queued rows.
+  int size() const { return rows_.num_rows() - head_; }
+
+  // speech holds a flag per row, nullptr marks them all as speech.
+  void Push(FeatureView rows, const uint8_t* speech = nullptr) {
+    CHECK(rows.empty() || rows.num_cols() == num_cols());
+    int n = rows.num_rows();
+    if (n > 0) {
+      memcpy(AppendRows(n, speech), rows.data(), sizeof(float) * rows.size());
+    }
+  }
+
+  // Queue n rows to be written by the caller, return the first of them.
+  float* AppendRows(int n, const uint8_t* speech = nullptr) {
+    if (speech != nullptr) {
+      speech_.insert(speech_.end(), speech, speech + n);
+    } else {
+      speech_.resize(speech_.size() + n, 1);
+    }
+    return rows_.AppendRows(n);
+  }
+
+  // Move the n oldest rows to feats, which is resized to n x num_cols().
+  // has_speech tells if any of them is speech.
+  void Pop(int n, FeatureMatrix* feats, bool* has_speech = nullptr) {
+    CHECK(n <= size());
+    feats->Resize(n, num_cols());
+    if (n > 0) {
+      memcpy(feats->data(), rows_.Row(head_), sizeof(float) * n * num_cols());
+    }
+    if (has_speech != nullptr) *has_speech = HasSpeech(n);
+    head_ += n;
+    Compact();
+  }
+
+  // Whether any of the n oldest rows is speech.
+  bool HasSpeech(int n) const {
+    CHECK(n <= size());
+    return std::find(speech_.begin() + head_, speech_.begin() + head_ + n,
+                     1) != speech_.begin() + head_ + n;
+  }
+
+  void Clear() {
+    rows_.Clear();
+    speech_.clear();
+    head_ = 0;
+  }
+
+ private:
+  void Compact() {
+    int live = size();
+    if (head_ < live) return;
+    if (live > 0) {
+      memmove(rows_.data(), rows_.Row(head_),
+              sizeof(float) * live * num_cols());
+    }
+    rows_.Resize(live, num_cols());
+    speech_.erase(speech_.begin(), speech_.begin() + head_);
+    head_ = 0;
+  }
+
+  FeatureMatrix rows_;
+  std::vector<uint8_t> speech_;
+  // first queued row of rows_
+  int head_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_FEATURE_MATRIX_H_
@@ -15,196 +15,229 @@
 
 #include "frontend/feature_pipeline.h"
 
+#include <string.h>
+
 #include <algorithm>
 #include <utility>
 
+#include "frontend/pcm_convert.h"
+
 namespace wenet {
 
+    // Samples kept by the ring, enough for 32 frames per fbank call.
+    static int RingCapacity(const FeaturePipelineConfig &config) {
+        return config.frame_length + 32 * config.frame_shift;
+    }
+
+    // Dim of the features fed to the model.
+    static int OutputDim(const FeaturePipelineConfig &config) {
+        if (config.model_type == CTC_TYPE_MODEL) {
+            return config.num_bins * (config.left_context + config.right_context + 1);
+        }
+        return config.num_bins;
+    }
+
+    // Queued rows of the vad pre-roll, the ctc models keep one frame in
+    // downsampling.
+    static int PreRollRows(const FeaturePipelineConfig &config) {
+        if (!config.use_vad) return 0;
+        int frames = std::max(config.vad_config.pre_roll_frames, 0);
+        if (config.model_type == CTC_TYPE_MODEL) {
+            return (frames + config.downsampling - 1) / config.downsampling;
+        }
+        return frames;
+    }
+
     FeaturePipeline::FeaturePipeline(const FeaturePipelineConfig &config)
             : config_(config),
               feature_dim_(config.num_bins),
-              fbank_(config.num_bins, config.sample_rate, config.frame_length,
-                     config.frame_shift),
+              fbank_(CreateFbank(config.num_bins, config.sample_rate,
+                                 config.frame_length, config.frame_shift)),
+              feature_queue_(OutputDim(config)),
               num_frames_(0),
-              input_finished_(false) {}
-
-    void FeaturePipeline::AcceptWaveform(const std::vector<float> &wav) {
-        std::vector<std::vector<float>> feats;
-        std::vector<float> waves;
-        waves.insert(waves.end(), remained_wav_.begin(), remained_wav_.end());
-        waves.insert(waves.end(), wav.begin(), wav.end());
-        int num_frames = fbank_.Compute(waves, &feats); // feats.shape=(frames, mel_num_bins)
-
-        if (config_.model_type==CTC_TYPE_MODEL){
-            int left_context = config_.left_context, right_context = config_.right_context;
-
-            // 处理CTC Loss的模型的特征输入，参考https://modelscope.cn/studios/thuduj12/KWS_Nihao_Xiaojing/file/view/master/stream_kws_ctc.py
-            // 将mel_num_bins=80的音频数据处理成dim=400的数据
-            std::vector<std::vector<float>> feats_pad;
-            if(!feature_remained.empty()){
-                feats_pad.insert(feats_pad.end(), feature_remained.begin(), feature_remained.end());
-                feats_pad.insert(feats_pad.end(), feats.begin(), feats.end());
-                feature_remained.clear(); // clear for updating later.
-            }else{
-                feats_pad = std::move(padFeatures(feats, left_context));
-            }
-            std::vector<std::vector<float>> feats_ctx = extractContext(feats_pad, left_context,
-                                                                       right_context);
-
-            // update feature remained, and feats
-            int feature_remained_size = left_context + right_context;
-            if (feature_remained_size <= feats.size()){
-                int start_index = feats.size() - feature_remained_size;
-                feature_remained.assign(feats.begin() + start_index, feats.end());
-            }
-
-            //对序列进行skip采样，降低重复计算。
-//            int last_remainder = 0;
-//            int remainder = (feats.size() + last_remainder) % this->config_.downsampling;
-            // 对feats_ctx特征进行切片，按照step进行。
-            std::vector<std::vector<float>> feats_down = slice(feats_ctx, 0, config_.downsampling);
-
-
-            for (size_t i = 0; i < feats_down.size(); ++i) {
-                feature_queue_.Push(std::move(feats_down[i]));
-            }
-        }else{
-            for (size_t i = 0; i < feats.size(); ++i) {
-                feature_queue_.Push(std::move(feats[i]));
-            }
+              input_finished_(false),
+              ring_(RingCapacity(config), config.frame_length),
+              fbank_feats_(0, config.num_bins),
+              vad_(config.vad_config),
+              pre_roll_rows_(PreRollRows(config)),
+              splicer_(config.num_bins, config.left_context,
+                       config.right_context, config.downsampling) {
+        CHECK(config.num_channels >= 1 && config.channel < config.num_channels);
+        if (config.input_sample_rate != config.sample_rate) {
+            resampler_.reset(new Resampler(config.input_sample_rate, config.sample_rate));
         }
+    }
 
-        num_frames_ += num_frames;
-
-        int left_samples = waves.size() - config_.frame_shift * num_frames;
-        remained_wav_.resize(left_samples);
-        std::copy(waves.begin() + config_.frame_shift * num_frames, waves.end(),
-                  remained_wav_.begin());
-        // We are still adding wave, notify input is not finished
-        finish_condition_.notify_one();
+    void FeaturePipeline::AcceptWaveform(const std::vector<float> &wav) {
+        AcceptWaveform(wav.data(), wav.size());
     }
 
     void FeaturePipeline::AcceptWaveform(const std::vector<int16_t> &wav) {
-        std::vector<float> float_wav(wav.size());
-        for (size_t i = 0; i < wav.size(); i++) {
-            float_wav[i] = static_cast<float>(wav[i]);
-        }
-        this->AcceptWaveform(float_wav);
+        AcceptWaveform(wav.data(), wav.size());
     }
 
-    void FeaturePipeline::set_input_finished() {
-        CHECK(!input_finished_);
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            input_finished_ = true;
-            feature_remained.clear();
+    void FeaturePipeline::ToMono(const float *wav, size_t num_frames, float *out) const {
+        if (config_.num_channels == 1) {
+            memcpy(out, wav, sizeof(float) * num_frames);
+        } else if (config_.channel < 0) {
+            Downmix(wav, num_frames, config_.num_channels, out);
+        } else {
+            SelectChannel(wav, num_frames, config_.num_channels, config_.channel, out);
         }
-        finish_condition_.notify_one();
     }
 
-    bool FeaturePipeline::ReadOne(std::vector<float> *feat) {
-        if (!feature_queue_.Empty()) {
-            *feat = std::move(feature_queue_.Pop());
-            return true;
+    void FeaturePipeline::ToMono(const int16_t *wav, size_t num_frames, float *out) const {
+        if (config_.num_channels == 1) {
+            Int16ToFloat(wav, num_frames, out);
+        } else if (config_.channel < 0) {
+            Downmix(wav, num_frames, config_.num_channels, out);
         } else {
-            std::unique_lock<std::mutex> lock(mutex_);
-            while (!input_finished_) {
-                // This will release the lock and wait for notify_one()
-                // from AcceptWaveform() or set_input_finished()
-                finish_condition_.wait(lock);
-                if (!feature_queue_.Empty()) {
-                    *feat = std::move(feature_queue_.Pop());
-                    return true;
-                }
-            }
-            CHECK(input_finished_);
-            // Double check queue.empty, see issue#893 for detailed discussions.
-            if (!feature_queue_.Empty()) {
-                *feat = std::move(feature_queue_.Pop());
-                return true;
-            } else {
-                return false;
-            }
+            SelectChannel(wav, num_frames, config_.num_channels, config_.channel, out);
         }
     }
 
-    bool FeaturePipeline::Read(int num_frames,
-                               std::vector<std::vector<float>> *feats) {
-        feats->clear();
-        std::vector<float> feat;
-        while (feats->size() < num_frames) {
-            if (ReadOne(&feat)) {
-                feats->push_back(std::move(feat));
-            } else {
-                return false;
-            }
+    // Write the chunk to the ring, in pieces when it is longer than the
+    // free space, and compute the complete frames in place.
+    template <typename T>
+    void FeaturePipeline::Accept(const T *wav, size_t num_samples) {
+        const int num_channels = config_.num_channels;
+        CHECK(num_samples % num_channels == 0);
+        size_t num_frames = num_samples / num_channels;
+        if (resampler_ != nullptr) {
+            ToMono(wav, num_frames, resampler_->BeginAccept(num_frames));
+            PushFeatures(ResampleFrames());
+            return;
         }
-        return true;
+        int num_feats = 0;
+        while (num_frames > 0) {
+            int n = std::min(num_frames, static_cast<size_t>(ring_.space()));
+            ToMono(wav, n, ring_.BeginWrite(n));
+            ring_.CommitWrite(n);
+            wav += n * num_channels;
+            num_frames -= n;
+            num_feats += ComputeFrames();
+        }
+        PushFeatures(num_feats);
     }
 
-    void FeaturePipeline::Reset() {
-        input_finished_ = false;
-        num_frames_ = 0;
-        remained_wav_.clear();
-        feature_queue_.Clear();
+    void FeaturePipeline::AcceptWaveform(const float *wav, size_t num_samples) {
+        Accept(wav, num_samples);
     }
 
-    std::vector<std::vector<float>>
-    FeaturePipeline::padFeatures(const std::vector<std::vector<float>> &feats, int leftContext) {
-        // 获取特征矩阵的行数和列数
-        size_t numRows = feats.size();
-        size_t numCols = feats[0].size();
-
-        // 计算填充后的特征矩阵的列数
-        size_t paddedRows = numRows + leftContext;
-
-        // 创建填充后的特征矩阵
-        std::vector<std::vector<float>> paddedFeats(paddedRows, std::vector<float>(numCols));
-
-        // 复制原始特征到填充后的特征矩阵中
-        for (size_t i = 0; i < numRows; ++i) {
-            // 复制原始特征到填充后的特征矩阵的右侧
-            std::copy(feats[i].begin(), feats[i].end(), paddedFeats[i + leftContext].begin());
+    void FeaturePipeline::AcceptWaveform(const int16_t *wav, size_t num_samples) {
+        Accept(wav, num_samples);
+    }
 
-            // 使用最边缘的元素复制填充特征到填充后的特征矩阵的左侧
-            for (int j = 0; j < leftContext; ++j) {
-                std::copy(feats[0].begin(), feats[0].end(), paddedFeats[j].begin()); // 使用第一行的元素进行复制
-            }
+    int FeaturePipeline::ResampleFrames() {
+        int num_frames = 0;
+        while (true) {
+            int space = ring_.space();
+            int n = resampler_->Read(ring_.BeginWrite(space), space);
+            ring_.CommitWrite(n);
+            if (n == 0) break;
+            num_frames += ComputeFrames();
         }
+        return num_frames;
+    }
 
-        return paddedFeats;
+    FeatureMatrix *FeaturePipeline::FbankOutput() {
+        // The ctc models splice the fbank frames with their context, they
+        // are appended after the context frames kept by the splicer.
+        if (config_.model_type == CTC_TYPE_MODEL) return splicer_.frames();
+        return &fbank_feats_;
     }
 
+    std::vector<uint8_t> *FeaturePipeline::FbankSpeech() {
+        if (config_.model_type == CTC_TYPE_MODEL) return splicer_.speech();
+        return &fbank_speech_;
+    }
 
-    std::vector<std::vector<float>> FeaturePipeline::extractContext(const std::vector<std::vector<float>> &
-    featsPad, int leftContext, int rightContext) {
-        int ctxFrm = featsPad.size() - (leftContext + rightContext);
-        int ctxWin = leftContext + rightContext + 1;
-        int ctxDim = featsPad[0].size() * ctxWin;
+    int FeaturePipeline::ComputeFrames() {
+        FeatureMatrix *feats = FbankOutput();
+        int offset = feats->num_rows();
+        log_energy_.clear();
+        int frames = fbank_->Compute(ring_.data(), ring_.size(), feats,
+                                     config_.use_vad ? &log_energy_ : nullptr); // feats.shape=(frames, mel_num_bins)
+        ring_.Consume(frames * config_.frame_shift);
+        std::vector<uint8_t> *speech = FbankSpeech();
+        speech->resize(speech->size() + frames, 1);
+        if (config_.use_vad && frames > 0) {
+            // the vad reuses the log mel energies and the log energies of
+            // the power spectra computed by the fbank
+            vad_.Process(feats->Row(offset), feats->num_cols(), log_energy_.data(),
+                         frames, speech->data() + speech->size() - frames);
+        }
+        return frames;
+    }
 
-        std::vector<std::vector<float>> featsCtx(ctxFrm, std::vector<float>(ctxDim, 0.0));
+    void FeaturePipeline::PushFeatures(int num_frames) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (config_.model_type==CTC_TYPE_MODEL){
+                // 处理CTC Loss的模型的特征输入，参考https://modelscope.cn/studios/thuduj12/KWS_Nihao_Xiaojing/file/view/master/stream_kws_ctc.py
+                // 将mel_num_bins=80的音频数据处理成dim=400的数据, 每downsampling帧只保留一帧,
+                // 直接写入feature_queue_.
+                splicer_.Splice(&feature_queue_);
+            }else{
+                feature_queue_.Push(fbank_feats_, fbank_speech_.data());
+                fbank_feats_.Clear();
+                fbank_speech_.clear();
+            }
+            num_frames_ += num_frames;
+        }
 
-        for (int i = 0; i < ctxFrm; ++i) {
-            int start = i;
-            int end = i + ctxWin;
-            int index = 0;
+        // We are still adding wave, notify input is not finished
+        finish_condition_.notify_one();
+    }
 
-            for (int j = start; j < end; ++j) {
-                for (int k = 0; k < featsPad[j].size(); ++k) {
-                    featsCtx[i][index] = featsPad[j][k];
-                    ++index;
-                }
-            }
+    void FeaturePipeline::set_input_finished() {
+        CHECK(!input_finished_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            input_finished_ = true;
+            splicer_.Reset();
         }
+        finish_condition_.notify_one();
+    }
 
-        return featsCtx;
+    bool FeaturePipeline::ReadOne(std::vector<float> *feat) {
+        FeatureMatrix feats;
+        if (!Read(1, &feats)) return false;
+        feat->assign(feats.Row(0), feats.Row(0) + feats.num_cols());
+        return true;
     }
 
-    std::vector<std::vector<float>> FeaturePipeline::slice(const std::vector<std::vector<float>>& data, int start, int step) {
-        std::vector<std::vector<float>> result;
-        for (int i = start; i < data.size(); i += step) {
-            result.push_back(data[i]);
+    bool FeaturePipeline::Read(int num_frames, FeatureMatrix *feats,
+                               bool *has_speech) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // This will release the lock and wait for notify_one()
+        // from AcceptWaveform() or set_input_finished()
+        // The pre-roll rows after the ones read are queued too, the read
+        // ones are speech if those are.
+        const int ahead = num_frames + pre_roll_rows_;
+        while (feature_queue_.size() < ahead && !input_finished_) {
+            finish_condition_.wait(lock);
+        }
+        int n = std::min(num_frames, feature_queue_.size());
+        if (has_speech != nullptr) {
+            *has_speech = feature_queue_.HasSpeech(
+                    std::min(ahead, feature_queue_.size()));
         }
-        return result;
+        feature_queue_.Pop(n, feats);
+        return n == num_frames;
     }
+
+    void FeaturePipeline::Reset() {
+        input_finished_ = false;
+        num_frames_ = 0;
+        ring_.Clear();
+        fbank_feats_.Clear();
+        fbank_speech_.clear();
+        splicer_.Reset();
+        vad_.Reset();
+        if (resampler_ != nullptr) resampler_->Reset();
+        std::lock_guard<std::mutex> lock(mutex_);
+        feature_queue_.Clear();
+    }
+
 }  // namespace wenet
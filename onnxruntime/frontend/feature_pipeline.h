@@ -16,14 +16,22 @@
 #ifndef FRONTEND_FEATURE_PIPELINE_H_
 #define FRONTEND_FEATURE_PIPELINE_H_
 
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <vector>
 
+#include "frontend/context_splicer.h"
 #include "frontend/fbank.h"
+#include "frontend/feature_matrix.h"
+#include "frontend/fixed_fbank.h"
+#include "frontend/resampler.h"
+#include "frontend/sample_ring.h"
+#include "frontend/vad.h"
 #include "utils/log.h"
-#include "utils/blocking_queue.h"
 
 namespace wenet {
 
@@ -35,28 +43,44 @@ namespace wenet {
     struct FeaturePipelineConfig {
         int num_bins;
         int sample_rate;
+        int input_sample_rate;  // rate of the accepted wav, resampled to sample_rate
+        int num_channels;       // interleaved channels of the accepted wav
+        int channel;            // channel kept of multi-channel wav, -1 to downmix
         int frame_length;
         int frame_shift;
         int left_context;
         int right_context;
         int downsampling;
         MODEL_TYPE model_type; // 1:ctc 0: max-pooling
+        bool use_vad;          // mark the frames as speech or not, see Read()
+        VadConfig vad_config;
 
         FeaturePipelineConfig(int num_bins, int sample_rate, MODEL_TYPE model_type)
                 : num_bins(num_bins),                  // 80 dim fbank. feature dim of mel-spectrogram.
                   sample_rate(sample_rate),           // 16k sample rate of audio
+                  input_sample_rate(sample_rate),
+                  num_channels(1),
+                  channel(0),
                   model_type(model_type) {
             frame_length = sample_rate / 1000 * 25;  // frame length 25ms, window_size
             frame_shift = sample_rate / 1000 * 10;   // frame shift 10ms, window_shift
             left_context = 2;                       // context_expansion_conf in config.yaml.
             right_context = 2;
             downsampling = 3;
+            use_vad = false;
         }
 
         void Info() const {
             LOG(INFO) << "feature pipeline config"
                       << " num_bins " << num_bins << " frame_length " << frame_length
                       << " frame_shift " << frame_shift;
+            if (input_sample_rate != sample_rate) {
+                LOG(INFO) << "resample " << input_sample_rate << " to " << sample_rate;
+            }
+            if (num_channels > 1) {
+                LOG(INFO) << num_channels << " channels, "
+                          << (channel < 0 ? "downmix" : "keep channel " + std::to_string(channel));
+            }
         }
     };
 
@@ -77,6 +101,18 @@ namespace wenet {
 
         void AcceptWaveform(const std::vector<int16_t> &wav);
 
+        // Span versions, the samples are written straight into the framing
+        // ring (int16 is converted on the way) without any temporary copy.
+        // When config.input_sample_rate differs from config.sample_rate they
+        // go through the resampler first, which writes into the ring.
+        // With config.num_channels > 1, wav holds interleaved frames and
+        // num_samples counts all their samples, the kept channel or the
+        // downmix is extracted on the way. See MultiChannelPipeline to spot
+        // on every channel.
+        void AcceptWaveform(const float *wav, size_t num_samples);
+
+        void AcceptWaveform(const int16_t *wav, size_t num_samples);
+
         // Current extracted frames number.
         int num_frames() const { return num_frames_; }
 
@@ -102,7 +138,13 @@ namespace wenet {
         // Return True if #num_frames features are read.
         // This function is a blocking method when there is no feature
         // in feature_queue_ and the input is not finished.
-        bool Read(int num_frames, std::vector<std::vector<float>> *feats);
+        // feats is resized to the frames read, they are copied from the
+        // queue at once. With use_vad, has_speech tells if any of them is
+        // speech, or any of the vad_config.pre_roll_frames after them, the
+        // caller can skip the model on the others. Those frames are waited
+        // for as well. It is always true without use_vad.
+        bool Read(int num_frames, FeatureMatrix *feats,
+                  bool *has_speech = nullptr);
 
         void Reset();
 
@@ -110,38 +152,91 @@ namespace wenet {
             return input_finished_ && (frame == num_frames_ - 1);
         }
 
-        int NumQueuedFrames() const { return feature_queue_.Size(); }
-
-        std::vector<std::vector<float>> padFeatures(const std::vector<std::vector<float>> &feats, int leftContext);
+        int NumQueuedFrames() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return feature_queue_.size();
+        }
 
-        std::vector<std::vector<float>> extractContext(const std::vector<std::vector<float>> &
-        featsPad, int leftContext, int rightContext);
+        // Queued frames Read() returns without blocking, the ones followed
+        // by the vad pre-roll, or all of them once the input is finished.
+        int NumReadyFrames() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            int n = feature_queue_.size();
+            return input_finished_ ? n : std::max(n - pre_roll_rows_, 0);
+        }
 
-        std::vector<std::vector<float>> slice(const std::vector<std::vector<float>> &data, int start, int step);
+        // Dim of the queued features, num_bins spliced with the left and
+        // right context for the ctc models.
+        int output_dim() const { return feature_queue_.num_cols(); }
 
     private:
+        // Fbank feats of the current AcceptWaveform() call are appended to
+        // this matrix.
+        FeatureMatrix *FbankOutput();
+
+        // Speech flags of the frames appended to FbankOutput().
+        std::vector<uint8_t> *FbankSpeech();
+
+        // Compute the complete frames pending in ring_, append them to
+        // FbankOutput(), their speech flags to FbankSpeech() and drop their
+        // samples, return num frames.
+        int ComputeFrames();
+
+        // Write num_frames mono samples of the interleaved wav to out, int16
+        // samples are converted on the way.
+        void ToMono(const float *wav, size_t num_frames, float *out) const;
+
+        void ToMono(const int16_t *wav, size_t num_frames, float *out) const;
+
+        // Both AcceptWaveform() spans, straight from wav to the ring.
+        template <typename T>
+        void Accept(const T *wav, size_t num_samples);
+
+        // Resample the samples buffered in resampler_ into the ring and
+        // compute the frames, return num frames.
+        int ResampleFrames();
+
+        // Queue the fbank feats of one AcceptWaveform() call.
+        void PushFeatures(int num_frames);
+
         const FeaturePipelineConfig &config_;
         int feature_dim_;
-        Fbank fbank_;
+        std::unique_ptr<FbankBase> fbank_;
 
-        BlockingQueue<std::vector<float>> feature_queue_;
+        // Queued features, guarded by mutex_.
+        FeatureFifo feature_queue_;
         int num_frames_;
         bool input_finished_;
 
         // The feature extraction is done in AcceptWaveform().
-        // This wavefrom sample points are consumed by frame size.
-        // The residual wavefrom sample points after framing are
-        // kept to be used in next AcceptWaveform() calling.
-        std::vector<float> remained_wav_;
+        // The wavefrom sample points are written to this ring and framed
+        // in place. The residual sample points after framing stay in the
+        // ring for the next AcceptWaveform() calling.
+        SampleRing ring_;
+
+        // Converts input_sample_rate to sample_rate in front of the ring,
+        // null when they are equal.
+        std::unique_ptr<Resampler> resampler_;
 
         // Used to block the Read when there is no feature in feature_queue_
         // and the input is not finished.
         mutable std::mutex mutex_;
         std::condition_variable finish_condition_;
 
-        std::vector<std::vector<float>> feature_remained;
+        // fbank feats of the current AcceptWaveform() call, for the
+        // max-pooling models
+        FeatureMatrix fbank_feats_;
+        std::vector<uint8_t> fbank_speech_;
 
+        // Voice activity detection, with use_vad.
+        Vad vad_;
+        std::vector<float> log_energy_;
+        // queued rows looked ahead by Read() for a speech onset
+        const int pre_roll_rows_;
 
+        // Context expansion and downsampling for the ctc models, it keeps
+        // the fbank frames needed as left/right context across calls.
+        ContextSplicer splicer_;
     };
 
 }  // namespace wenet
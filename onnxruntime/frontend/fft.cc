@@ -118,4 +118,42 @@ int fft(const int* bitrev, const float* sintbl, float* x, float* y, int n) {
   return 0; /* finished successfully */
 }
 
+int rfft_power(const int* bitrev, const float* sintbl, const float* rsintbl,
+               float* x, float* y, float* power, int n) {
+  int k, n2, n4;
+  float ar, ai, br, bi, er, ei, or_, oi, c, s, xr, xi;
+
+  n2 = n / 2;
+  n4 = n / 4;
+  if (n2 == 0) {
+    return 0;
+  }
+
+  /* pack even samples as real part, odd samples as image part */
+  for (k = 0; k < n2; ++k) {
+    y[k] = x[2 * k + 1];
+    x[k] = x[2 * k];
+  }
+  fft(bitrev, sintbl, x, y, n2);
+
+  /* split the n/2 point spectrum into the n point spectrum of real input */
+  power[0] = (x[0] + y[0]) * (x[0] + y[0]);
+  for (k = 1; k < n2; ++k) {
+    ar = x[k];
+    ai = y[k];
+    br = x[n2 - k];
+    bi = y[n2 - k];
+    er = 0.5f * (ar + br);
+    ei = 0.5f * (ai - bi);
+    or_ = 0.5f * (ai + bi);
+    oi = 0.5f * (br - ar);
+    c = rsintbl[k + n4];
+    s = rsintbl[k];
+    xr = er + c * or_ + s * oi;
+    xi = ei + c * oi - s * or_;
+    power[k] = xr * xr + xi * xi;
+  }
+  return 0;
+}
+
 }  // namespace wenet
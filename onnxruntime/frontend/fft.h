@@ -20,6 +20,17 @@ void make_bitrev(int n, int* bitrev);
 
 int fft(const int* bitrev, const float* sintbl, float* x, float* y, int n);
 
+// Real-input FFT returning the power spectrum of bins [0, n/2).
+// The n real samples are packed as n/2 complex points, transformed with fft()
+// and separated with a post-twiddle pass.
+// bitrev, sintbl: tables made for n/2 points
+// rsintbl: trigonometric function table made for n points
+// x: n real samples, used as scratch
+// y: n/2 floats of scratch
+// power: output, n/2 floats
+int rfft_power(const int* bitrev, const float* sintbl, const float* rsintbl,
+               float* x, float* y, float* power, int n);
+
 }  // namespace wenet
 
 #endif  // FRONTEND_FFT_H_
@@ -0,0 +1,329 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_FIXED_FBANK_H_
+#define FRONTEND_FIXED_FBANK_H_
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "frontend/fbank.h"
+#include "frontend/frame_preprocess.h"
+#include "frontend/mel_banks.h"
+#include "utils/aligned_allocator.h"
+
+namespace wenet {
+
+namespace fixed_fbank {
+
+// constexpr versions of the math used to build the fbank tables, C++14 has
+// no constexpr <cmath>.
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kLn2 = 0.69314718055994530942;
+
+constexpr double Sin(double x) {
+  while (x > kPi) x -= 2 * kPi;
+  while (x < -kPi) x += 2 * kPi;
+  double term = x, sum = x;
+  for (int i = 1; i < 24; ++i) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double Cos(double x) { return Sin(x + kPi / 2); }
+
+// x > 0
+constexpr double Log(double x) {
+  int e = 0;
+  while (x > 2) {
+    x /= 2;
+    ++e;
+  }
+  while (x < 1) {
+    x *= 2;
+    --e;
+  }
+  // log(x) = 2 * atanh((x - 1) / (x + 1))
+  double y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+  for (int i = 0; i < 32; ++i) {
+    sum += term / (2 * i + 1);
+    term *= y2;
+  }
+  return 2 * sum + e * kLn2;
+}
+
+constexpr double MelScale(double freq) {
+  return 1127.0 * Log(1.0 + freq / 700.0);
+}
+
+constexpr int BitReverse(int i, int n) {
+  int r = 0;
+  for (int k = 1; k < n; k <<= 1) {
+    r = (r << 1) | (i & 1);
+    i >>= 1;
+  }
+  return r;
+}
+
+// The filters are the ones of Fbank: num_bins triangles evenly spaced on
+// the mel scale between 20 Hz and nyquist, sampled at the fft bin centers.
+template <int NumBins, int FftLen, int SampleRate>
+struct MelLayout {
+  static constexpr int kNumFftBins = FftLen / 2;
+
+  int first[NumBins] = {};
+  int last[NumBins] = {};
+  double weights[NumBins][kNumFftBins] = {};
+
+  constexpr MelLayout() {
+    double mel[kNumFftBins] = {};
+    const double fft_bin_width = static_cast<double>(SampleRate) / FftLen;
+    for (int i = 0; i < kNumFftBins; ++i) mel[i] = MelScale(fft_bin_width * i);
+    const double mel_low_freq = MelScale(20);
+    const double mel_high_freq = MelScale(SampleRate / 2);
+    const double mel_freq_delta =
+        (mel_high_freq - mel_low_freq) / (NumBins + 1);
+    for (int bin = 0; bin < NumBins; ++bin) {
+      double left_mel = mel_low_freq + bin * mel_freq_delta,
+             center_mel = mel_low_freq + (bin + 1) * mel_freq_delta,
+             right_mel = mel_low_freq + (bin + 2) * mel_freq_delta;
+      first[bin] = -1;
+      for (int i = 0; i < kNumFftBins; ++i) {
+        if (mel[i] > left_mel && mel[i] < right_mel) {
+          weights[bin][i] = mel[i] <= center_mel
+                                ? (mel[i] - left_mel) / (center_mel - left_mel)
+                                : (right_mel - mel[i]) / (right_mel - center_mel);
+          if (first[bin] == -1) first[bin] = i;
+          last[bin] = i;
+        }
+      }
+    }
+  }
+
+  // Widest filter, padded to a multiple of 8 like MelBanks.
+  constexpr int PaddedWidth() const {
+    int width = 1;
+    for (int bin = 0; bin < NumBins; ++bin) {
+      int size = last[bin] + 1 - first[bin];
+      if (size > width) width = size;
+    }
+    width = (width + 7) / 8 * 8;
+    return width < kNumFftBins ? width : kNumFftBins;
+  }
+};
+
+// Every table of the fbank, built at compile time.
+template <int NumBins, int FrameLen, int FftLen, int SampleRate>
+struct Tables {
+  static constexpr int kNumFftBins = FftLen / 2;
+  static constexpr int kWidth =
+      MelLayout<NumBins, FftLen, SampleRate>().PaddedWidth();
+
+  // hamming window
+  float window[FrameLen] = {};
+  // bit reversal table of the fft of FftLen / 2 points
+  int bitrev[FftLen / 2] = {};
+  // trigonometric function table of the fft of FftLen / 2 points
+  float sintbl[FftLen / 2 + FftLen / 8] = {};
+  // trigonometric function table of the real fft post-twiddle
+  float rsintbl[FftLen + FftLen / 4] = {};
+  // first fft bin of each padded filter and the NumBins x kWidth weights
+  int offsets[NumBins] = {};
+  alignas(kSimdAlignment) float weights[NumBins * kWidth] = {};
+
+  constexpr Tables() {
+    const double a = 2 * kPi / (FrameLen - 1);
+    for (int i = 0; i < FrameLen; ++i) {
+      window[i] = static_cast<float>(0.54 - 0.46 * Cos(a * i));
+    }
+    const int half = FftLen / 2;
+    for (int i = 0; i < half; ++i) bitrev[i] = BitReverse(i, half);
+    for (int i = 0; i < half + half / 4; ++i) {
+      sintbl[i] = static_cast<float>(Sin(2 * kPi * i / half));
+    }
+    for (int i = 0; i < FftLen + FftLen / 4; ++i) {
+      rsintbl[i] = static_cast<float>(Sin(2 * kPi * i / FftLen));
+    }
+    const MelLayout<NumBins, FftLen, SampleRate> layout;
+    for (int bin = 0; bin < NumBins; ++bin) {
+      int first = layout.first[bin];
+      int offset = first < kNumFftBins - kWidth ? first : kNumFftBins - kWidth;
+      offsets[bin] = offset;
+      for (int i = first; i <= layout.last[bin]; ++i) {
+        weights[bin * kWidth + i - offset] =
+            static_cast<float>(layout.weights[bin][i]);
+      }
+    }
+  }
+};
+
+}  // namespace fixed_fbank
+
+// Fbank specialized at compile time for one configuration. The window,
+// twiddle and filterbank tables are constexpr, shared by every instance and
+// built by the compiler, and every loop has a constant trip count. Results
+// match Fbank up to float rounding of the tables.
+template <int NumBins, int FrameLen, int FftLen, int SampleRate = 16000>
+class FixedFbank : public FbankBase {
+ public:
+  static_assert((FftLen & (FftLen - 1)) == 0, "FftLen is not a power of 2");
+  static_assert(FrameLen <= FftLen, "FrameLen does not fit the fft");
+  static_assert(FftLen >= 16, "FftLen is too small");
+
+  typedef fixed_fbank::Tables<NumBins, FrameLen, FftLen, SampleRate> Tables;
+  static constexpr int kNumFftBins = FftLen / 2;
+  static constexpr int kWidth = Tables::kWidth;
+
+  explicit FixedFbank(int frame_shift)
+      : frame_shift_(frame_shift),
+        use_log_(true),
+        remove_dc_offset_(true),
+        dither_(0.0) {
+    memset(fft_real_, 0, sizeof(fft_real_));
+  }
+
+  void set_use_log(bool use_log) { use_log_ = use_log; }
+
+  void set_remove_dc_offset(bool remove_dc_offset) {
+    remove_dc_offset_ = remove_dc_offset;
+  }
+
+  void set_dither(float dither) { dither_ = dither; }
+
+  int num_bins() const override { return NumBins; }
+  int frame_length() const override { return FrameLen; }
+  int frame_shift() const override { return frame_shift_; }
+
+  int Compute(const float* wave, int num_samples, FeatureMatrix* feat,
+              std::vector<float>* log_energy = nullptr) override {
+    if (num_samples < FrameLen) return 0;
+    int num_frames = 1 + ((num_samples - FrameLen) / frame_shift_);
+    power_.resize(num_frames * kNumFftBins);
+    for (int i = 0; i < num_frames; ++i) {
+      PreprocessFrame(wave + i * frame_shift_, FrameLen, dither_, &rng_,
+                      remove_dc_offset_, 0.97, kTables.window, fft_real_);
+      PowerSpectrum(power_.data() + i * kNumFftBins);
+    }
+    float* mel = AppendFrames(num_frames, feat);
+    MelFilter(kTables.weights, kTables.offsets, NumBins, kWidth,
+              power_.data(), kNumFftBins, num_frames, mel, NumBins);
+    if (use_log_) LogFloor(mel, num_frames * NumBins);
+    AppendLogEnergy(power_.data(), kNumFftBins, num_frames, log_energy);
+    return num_frames;
+  }
+
+ private:
+  // Real input fft of fft_real_, see rfft_power() in frontend/fft.cc. The
+  // packing and the bit reversal are one gather from fft_real_ into x and y,
+  // and the first two stages, whose twiddles are 1 and -i, are one radix-4
+  // pass without multiplications.
+  void PowerSpectrum(float* power) {
+    const int n = FftLen / 2, n4 = n / 4;
+    const float* in = fft_real_;
+    float* x = fft_x_;
+    float* y = fft_y_;
+    for (int k = 0; k < n; ++k) {
+      x[kTables.bitrev[k]] = in[2 * k];
+      y[kTables.bitrev[k]] = in[2 * k + 1];
+    }
+    for (int i = 0; i < n; i += 4) {
+      float ar = x[i] + x[i + 1], ai = y[i] + y[i + 1];
+      float br = x[i] - x[i + 1], bi = y[i] - y[i + 1];
+      float cr = x[i + 2] + x[i + 3], ci = y[i + 2] + y[i + 3];
+      float dr = x[i + 2] - x[i + 3], di = y[i + 2] - y[i + 3];
+      x[i] = ar + cr;
+      y[i] = ai + ci;
+      x[i + 2] = ar - cr;
+      y[i + 2] = ai - ci;
+      // (dr + i * di) * -i
+      x[i + 1] = br + di;
+      y[i + 1] = bi - dr;
+      x[i + 3] = br - di;
+      y[i + 3] = bi + dr;
+    }
+    for (int k = 4; k < n; k *= 2) {
+      const int d = n / (2 * k);
+      for (int j = 0; j < k; ++j) {
+        const float c = kTables.sintbl[j * d + n4];
+        const float s = kTables.sintbl[j * d];
+        for (int i = j; i < n; i += 2 * k) {
+          const int ik = i + k;
+          float dx = s * y[ik] + c * x[ik];
+          float dy = c * y[ik] - s * x[ik];
+          x[ik] = x[i] - dx;
+          x[i] += dx;
+          y[ik] = y[i] - dy;
+          y[i] += dy;
+        }
+      }
+    }
+    power[0] = (x[0] + y[0]) * (x[0] + y[0]);
+    for (int k = 1; k < n; ++k) {
+      float er = 0.5f * (x[k] + x[n - k]);
+      float ei = 0.5f * (y[k] - y[n - k]);
+      float or_ = 0.5f * (y[k] + y[n - k]);
+      float oi = 0.5f * (x[n - k] - x[k]);
+      const float c = kTables.rsintbl[k + FftLen / 4];
+      const float s = kTables.rsintbl[k];
+      float xr = er + c * or_ + s * oi;
+      float xi = ei + c * oi - s * or_;
+      power[k] = xr * xr + xi * xi;
+    }
+  }
+
+  static constexpr Tables kTables{};
+
+  int frame_shift_;
+  bool use_log_;
+  bool remove_dc_offset_;
+  float dither_;
+  DitherRng rng_;
+
+  // windowed frame with its zero padding, and the half size complex fft
+  float fft_real_[FftLen];
+  float fft_x_[FftLen / 2];
+  float fft_y_[FftLen / 2];
+  AlignedVector<float> power_;
+};
+
+template <int NumBins, int FrameLen, int FftLen, int SampleRate>
+constexpr typename FixedFbank<NumBins, FrameLen, FftLen, SampleRate>::Tables
+    FixedFbank<NumBins, FrameLen, FftLen, SampleRate>::kTables;
+
+// Create the fbank extractor of a configuration, the specialized FixedFbank
+// for the 16k, 25ms window, 40 or 80 bins configurations and the runtime
+// configured Fbank otherwise.
+inline std::unique_ptr<FbankBase> CreateFbank(int num_bins, int sample_rate,
+                                              int frame_length,
+                                              int frame_shift) {
+  if (sample_rate == 16000 && frame_length == 400) {
+    if (num_bins == 40) {
+      return std::unique_ptr<FbankBase>(
+          new FixedFbank<40, 400, 512>(frame_shift));
+    }
+    if (num_bins == 80) {
+      return std::unique_ptr<FbankBase>(
+          new FixedFbank<80, 400, 512>(frame_shift));
+    }
+  }
+  return std::unique_ptr<FbankBase>(
+      new Fbank(num_bins, sample_rate, frame_length, frame_shift));
+}
+
+}  // namespace wenet
+
+#endif  // FRONTEND_FIXED_FBANK_H_
@@ -0,0 +1,175 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/frame_preprocess.h"
+
+#include <math.h>
+
+#include "frontend/fft.h"
+#include "utils/cpu_features.h"
+
+#ifdef WENET_X86
+#include <immintrin.h>
+#endif
+
+namespace wenet {
+
+namespace {
+
+inline uint64_t SplitMix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+float SumScalar(const float* data, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; ++i) sum += data[i];
+  return sum;
+}
+
+// out[j] = (src[j] - coeff * src[j - 1] - bias) * window[j] for j in
+// [begin, end), walking backward so that src may alias out.
+void EmphasizeScalar(const float* src, int begin, int end, float coeff,
+                     float bias, const float* window, float* out) {
+  for (int j = end - 1; j >= begin; --j) {
+    out[j] = (src[j] - coeff * src[j - 1] - bias) * window[j];
+  }
+}
+
+#ifdef WENET_X86
+
+float SumSse2(const float* data, int n) {
+  __m128 acc = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) acc = _mm_add_ps(acc, _mm_loadu_ps(data + i));
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 0x55));
+  return _mm_cvtss_f32(acc) + SumScalar(data + i, n - i);
+}
+
+void EmphasizeSse2(const float* src, int begin, int end, float coeff,
+                   float bias, const float* window, float* out) {
+  int num_blocks = (end - begin) / 4;
+  int tail = begin + num_blocks * 4;
+  EmphasizeScalar(src, tail, end, coeff, bias, window, out);
+  const __m128 c = _mm_set1_ps(coeff), b = _mm_set1_ps(bias);
+  for (int j = tail - 4; j >= begin; j -= 4) {
+    __m128 cur = _mm_loadu_ps(src + j);
+    __m128 prev = _mm_loadu_ps(src + j - 1);
+    __m128 x = _mm_sub_ps(_mm_sub_ps(cur, _mm_mul_ps(c, prev)), b);
+    _mm_storeu_ps(out + j, _mm_mul_ps(x, _mm_loadu_ps(window + j)));
+  }
+}
+
+#define WENET_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+WENET_TARGET_AVX2 float SumAvx2(const float* data, int n) {
+  __m256 acc = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_add_ps(acc, _mm256_loadu_ps(data + i));
+  }
+  __m128 x = _mm_add_ps(_mm256_castps256_ps128(acc),
+                        _mm256_extractf128_ps(acc, 1));
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 0x55));
+  return _mm_cvtss_f32(x) + SumScalar(data + i, n - i);
+}
+
+WENET_TARGET_AVX2 void EmphasizeAvx2(const float* src, int begin, int end,
+                                     float coeff, float bias,
+                                     const float* window, float* out) {
+  int num_blocks = (end - begin) / 8;
+  int tail = begin + num_blocks * 8;
+  EmphasizeScalar(src, tail, end, coeff, bias, window, out);
+  const __m256 c = _mm256_set1_ps(coeff), b = _mm256_set1_ps(bias);
+  for (int j = tail - 8; j >= begin; j -= 8) {
+    __m256 cur = _mm256_loadu_ps(src + j);
+    __m256 prev = _mm256_loadu_ps(src + j - 1);
+    __m256 x = _mm256_sub_ps(_mm256_fnmadd_ps(c, prev, cur), b);
+    _mm256_storeu_ps(out + j, _mm256_mul_ps(x, _mm256_loadu_ps(window + j)));
+  }
+}
+
+#endif  // WENET_X86
+
+}  // namespace
+
+float DitherRng::Gaussian() {
+  if (has_spare_) {
+    has_spare_ = false;
+    return spare_;
+  }
+  ++counter_;
+  uint64_t bits = SplitMix64(seed_ + counter_ * 0x9e3779b97f4a7c15ULL);
+  // two 24 bit uniforms, u1 in (0, 1] and u2 in [0, 1)
+  const float scale = 1.0f / 16777216.0f;
+  float u1 = (static_cast<float>(bits >> 40) + 1.0f) * scale;
+  float u2 = static_cast<float>((bits >> 16) & 0xffffff) * scale;
+  float r = sqrtf(-2.0f * logf(u1));
+  float theta = static_cast<float>(M_2PI) * u2;
+  spare_ = r * sinf(theta);
+  has_spare_ = true;
+  return r * cosf(theta);
+}
+
+void PreprocessFrame(const float* frame, int frame_length, float dither,
+                     DitherRng* rng, bool remove_dc_offset,
+                     float preemph_coeff, const float* window, float* out) {
+  const SimdLevel simd_level = GetSimdLevel();
+  const float* src = frame;
+  float sum = 0.0f;
+  if (dither != 0.0f) {
+    // The noise is added while summing, the output pass then runs in place.
+    for (int i = 0; i < frame_length; ++i) {
+      out[i] = frame[i] + dither * rng->Gaussian();
+      sum += out[i];
+    }
+    src = out;
+  } else if (remove_dc_offset) {
+    switch (simd_level) {
+#ifdef WENET_X86
+      case SIMD_AVX2:
+        sum = SumAvx2(frame, frame_length);
+        break;
+      case SIMD_SSE2:
+        sum = SumSse2(frame, frame_length);
+        break;
+#endif
+      default:
+        sum = SumScalar(frame, frame_length);
+    }
+  }
+  float mean = remove_dc_offset ? sum / frame_length : 0.0f;
+  // e[j] - c * e[j - 1] = d[j] - c * d[j - 1] - (1 - c) * mean
+  float bias = (1.0f - preemph_coeff) * mean;
+  float first = (1.0f - preemph_coeff) * (src[0] - mean) * window[0];
+  switch (simd_level) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+      EmphasizeAvx2(src, 1, frame_length, preemph_coeff, bias, window, out);
+      break;
+    case SIMD_SSE2:
+      EmphasizeSse2(src, 1, frame_length, preemph_coeff, bias, window, out);
+      break;
+#endif
+    default:
+      EmphasizeScalar(src, 1, frame_length, preemph_coeff, bias, window,
+                      out);
+  }
+  out[0] = first;
+}
+
+}  // namespace wenet
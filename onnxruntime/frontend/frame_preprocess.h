@@ -0,0 +1,53 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_FRAME_PREPROCESS_H_
+#define FRONTEND_FRAME_PREPROCESS_H_
+
+#include <cstdint>
+
+namespace wenet {
+
+// Counter based gaussian generator used for dithering. Every 64 bit draw is
+// splitmix64(seed + counter), turned into two N(0, 1) samples by Box-Muller,
+// so the generator state is a single counter.
+class DitherRng {
+ public:
+  explicit DitherRng(uint64_t seed = 0) : seed_(seed), counter_(0) {}
+
+  // Return a N(0, 1) sample.
+  float Gaussian();
+
+ private:
+  uint64_t seed_;
+  uint64_t counter_;
+  // second Box-Muller output of the last draw
+  float spare_ = 0.0f;
+  bool has_spare_ = false;
+};
+
+// Fused per frame preprocessing, equivalent to the kaldi sequence of
+// dither, dc offset removal, pre-emphasis and window:
+//   d[i] = frame[i] + dither * N(0, 1)
+//   e[i] = d[i] - mean(d), when remove_dc_offset
+//   out[i] = (e[i] - preemph_coeff * e[i - 1]) * window[i], e[-1] = e[0]
+// It makes a reduction pass for the mean and one output pass instead of a
+// pass per step. rng is only used when dither != 0. out may alias frame.
+void PreprocessFrame(const float* frame, int frame_length, float dither,
+                     DitherRng* rng, bool remove_dc_offset,
+                     float preemph_coeff, const float* window, float* out);
+
+}  // namespace wenet
+
+#endif  // FRONTEND_FRAME_PREPROCESS_H_
@@ -0,0 +1,351 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/mel_banks.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+#ifdef WENET_X86
+#include <immintrin.h>
+#endif
+
+#include "utils/log.h"
+
+namespace wenet {
+
+namespace {
+
+// Number of frames filtered together, each one keeps an accumulator register.
+const int kFrameBlock = 4;
+
+void FilterScalar(const float* weights, const int* offsets, int num_bins,
+                  int width, const float* power, int power_stride,
+                  int num_frames, float* mel, int mel_stride) {
+  for (int i = 0; i < num_frames; ++i) {
+    const float* p = power + i * power_stride;
+    float* m = mel + i * mel_stride;
+    for (int j = 0; j < num_bins; ++j) {
+      const float* w = weights + j * width;
+      const float* s = p + offsets[j];
+      float energy = 0.0f;
+      for (int k = 0; k < width; ++k) energy += w[k] * s[k];
+      m[j] = energy;
+    }
+  }
+}
+
+void LogFloorScalar(float* data, int n) {
+  const float epsilon = std::numeric_limits<float>::epsilon();
+  for (int i = 0; i < n; ++i) {
+    data[i] = logf(std::max(data[i], epsilon));
+  }
+}
+
+#ifdef WENET_X86
+
+// Cephes logf polynomial, as in sse_mathfun. Inputs are floored to epsilon
+// so denormals, zero and negative values never reach it.
+#define WENET_LOG_POLY(SET1, ADD, MUL)                             \
+  y = SET1(7.0376836292E-2f);                                      \
+  y = ADD(MUL(y, x), SET1(-1.1514610310E-1f));                     \
+  y = ADD(MUL(y, x), SET1(1.1676998740E-1f));                      \
+  y = ADD(MUL(y, x), SET1(-1.2420140846E-1f));                     \
+  y = ADD(MUL(y, x), SET1(1.4249322787E-1f));                      \
+  y = ADD(MUL(y, x), SET1(-1.6668057665E-1f));                     \
+  y = ADD(MUL(y, x), SET1(2.0000714765E-1f));                      \
+  y = ADD(MUL(y, x), SET1(-2.4999993993E-1f));                     \
+  y = ADD(MUL(y, x), SET1(3.3333331174E-1f));
+
+inline __m128 LogSse2(__m128 x) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128i emm0 = _mm_srli_epi32(_mm_castps_si128(x), 23);
+  x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+  x = _mm_or_ps(x, _mm_set1_ps(0.5f));
+  emm0 = _mm_sub_epi32(emm0, _mm_set1_epi32(0x7f));
+  __m128 e = _mm_add_ps(_mm_cvtepi32_ps(emm0), one);
+  __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+  __m128 tmp = _mm_and_ps(x, mask);
+  x = _mm_sub_ps(x, one);
+  e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+  x = _mm_add_ps(x, tmp);
+  __m128 z = _mm_mul_ps(x, x);
+  __m128 y;
+  WENET_LOG_POLY(_mm_set1_ps, _mm_add_ps, _mm_mul_ps)
+  y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+  y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+  y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+  x = _mm_add_ps(x, y);
+  return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+}
+
+void LogFloorSse2(float* data, int n) {
+  const __m128 epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_max_ps(_mm_loadu_ps(data + i), epsilon);
+    _mm_storeu_ps(data + i, LogSse2(x));
+  }
+  LogFloorScalar(data + i, n - i);
+}
+
+inline float HorizontalSum(__m128 x) {
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 0x55));
+  return _mm_cvtss_f32(x);
+}
+
+void FilterSse2(const float* weights, const int* offsets, int num_bins,
+                int width, const float* power, int power_stride,
+                int num_frames, float* mel, int mel_stride) {
+  int i = 0;
+  for (; i + kFrameBlock <= num_frames; i += kFrameBlock) {
+    const float* p = power + i * power_stride;
+    float* m = mel + i * mel_stride;
+    for (int j = 0; j < num_bins; ++j) {
+      const float* w = weights + j * width;
+      const float* s = p + offsets[j];
+      __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+      __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+      for (int k = 0; k < width; k += 4) {
+        __m128 wv = _mm_load_ps(w + k);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(wv, _mm_loadu_ps(s + k)));
+        acc1 = _mm_add_ps(
+            acc1, _mm_mul_ps(wv, _mm_loadu_ps(s + power_stride + k)));
+        acc2 = _mm_add_ps(
+            acc2, _mm_mul_ps(wv, _mm_loadu_ps(s + 2 * power_stride + k)));
+        acc3 = _mm_add_ps(
+            acc3, _mm_mul_ps(wv, _mm_loadu_ps(s + 3 * power_stride + k)));
+      }
+      m[j] = HorizontalSum(acc0);
+      m[mel_stride + j] = HorizontalSum(acc1);
+      m[2 * mel_stride + j] = HorizontalSum(acc2);
+      m[3 * mel_stride + j] = HorizontalSum(acc3);
+    }
+  }
+  for (; i < num_frames; ++i) {
+    const float* p = power + i * power_stride;
+    float* m = mel + i * mel_stride;
+    for (int j = 0; j < num_bins; ++j) {
+      const float* w = weights + j * width;
+      const float* s = p + offsets[j];
+      __m128 acc = _mm_setzero_ps();
+      for (int k = 0; k < width; k += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(w + k),
+                                         _mm_loadu_ps(s + k)));
+      }
+      m[j] = HorizontalSum(acc);
+    }
+  }
+}
+
+#define WENET_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+WENET_TARGET_AVX2 inline __m256 LogAvx2(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256i emm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+  x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000)));
+  x = _mm256_or_ps(x, _mm256_set1_ps(0.5f));
+  emm0 = _mm256_sub_epi32(emm0, _mm256_set1_epi32(0x7f));
+  __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(emm0), one);
+  __m256 mask =
+      _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OS);
+  __m256 tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+  __m256 z = _mm256_mul_ps(x, x);
+  __m256 y;
+  WENET_LOG_POLY(_mm256_set1_ps, _mm256_add_ps, _mm256_mul_ps)
+  y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), y);
+  y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+  x = _mm256_add_ps(x, y);
+  return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), x);
+}
+
+WENET_TARGET_AVX2 void LogFloorAvx2(float* data, int n) {
+  const __m256 epsilon =
+      _mm256_set1_ps(std::numeric_limits<float>::epsilon());
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_max_ps(_mm256_loadu_ps(data + i), epsilon);
+    _mm256_storeu_ps(data + i, LogAvx2(x));
+  }
+  LogFloorSse2(data + i, n - i);
+}
+
+WENET_TARGET_AVX2 inline float HorizontalSum(__m256 x) {
+  __m128 lo = _mm256_castps256_ps128(x);
+  __m128 hi = _mm256_extractf128_ps(x, 1);
+  return HorizontalSum(_mm_add_ps(lo, hi));
+}
+
+WENET_TARGET_AVX2 void FilterAvx2(const float* weights, const int* offsets,
+                                  int num_bins, int width, const float* power,
+                                  int power_stride, int num_frames,
+                                  float* mel, int mel_stride) {
+  int i = 0;
+  for (; i + kFrameBlock <= num_frames; i += kFrameBlock) {
+    const float* p = power + i * power_stride;
+    float* m = mel + i * mel_stride;
+    for (int j = 0; j < num_bins; ++j) {
+      const float* w = weights + j * width;
+      const float* s = p + offsets[j];
+      __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+      __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+      for (int k = 0; k < width; k += 8) {
+        __m256 wv = _mm256_load_ps(w + k);
+        acc0 = _mm256_fmadd_ps(wv, _mm256_loadu_ps(s + k), acc0);
+        acc1 = _mm256_fmadd_ps(wv, _mm256_loadu_ps(s + power_stride + k),
+                               acc1);
+        acc2 = _mm256_fmadd_ps(
+            wv, _mm256_loadu_ps(s + 2 * power_stride + k), acc2);
+        acc3 = _mm256_fmadd_ps(
+            wv, _mm256_loadu_ps(s + 3 * power_stride + k), acc3);
+      }
+      m[j] = HorizontalSum(acc0);
+      m[mel_stride + j] = HorizontalSum(acc1);
+      m[2 * mel_stride + j] = HorizontalSum(acc2);
+      m[3 * mel_stride + j] = HorizontalSum(acc3);
+    }
+  }
+  for (; i < num_frames; ++i) {
+    const float* p = power + i * power_stride;
+    float* m = mel + i * mel_stride;
+    for (int j = 0; j < num_bins; ++j) {
+      const float* w = weights + j * width;
+      const float* s = p + offsets[j];
+      __m256 acc = _mm256_setzero_ps();
+      for (int k = 0; k < width; k += 8) {
+        acc = _mm256_fmadd_ps(_mm256_load_ps(w + k), _mm256_loadu_ps(s + k),
+                              acc);
+      }
+      m[j] = HorizontalSum(acc);
+    }
+  }
+}
+
+#endif  // WENET_X86
+
+}  // namespace
+
+MelBanks::MelBanks(const std::vector<std::pair<int, std::vector<float>>>& bins,
+                   int num_fft_bins)
+    : num_bins_(bins.size()),
+      num_fft_bins_(num_fft_bins),
+      simd_level_(GetSimdLevel()) {
+  int max_width = 1;
+  for (const auto& bin : bins) {
+    max_width = std::max(max_width, static_cast<int>(bin.second.size()));
+  }
+  width_ = (max_width + 7) / 8 * 8;
+  if (width_ > num_fft_bins_) {
+    // Too few fft bins to pad the filters, the scalar kernel handles any
+    // width.
+    width_ = max_width;
+    simd_level_ = SIMD_SCALAR;
+  }
+  CHECK(width_ <= num_fft_bins_);
+
+  // Shift filters ending near the last fft bin to the left, so that every
+  // padded filter reads inside a power spectrum row.
+  offsets_.resize(num_bins_);
+  weights_.assign(num_bins_ * width_, 0.0f);
+  for (int j = 0; j < num_bins_; ++j) {
+    int first = bins[j].first;
+    int offset = std::min(first, num_fft_bins_ - width_);
+    offsets_[j] = offset;
+    float* w = weights_.data() + j * width_ + (first - offset);
+    std::copy(bins[j].second.begin(), bins[j].second.end(), w);
+  }
+}
+
+void MelBanks::Compute(const float* power, int power_stride, int num_frames,
+                       bool use_log, float* mel, int mel_stride) const {
+  if (simd_level_ == SIMD_SCALAR) {
+    FilterScalar(weights_.data(), offsets_.data(), num_bins_, width_, power,
+                 power_stride, num_frames, mel, mel_stride);
+  } else {
+    MelFilter(weights_.data(), offsets_.data(), num_bins_, width_, power,
+              power_stride, num_frames, mel, mel_stride);
+  }
+  if (!use_log) return;
+  if (mel_stride == num_bins_) {
+    LogFloor(mel, num_frames * num_bins_);
+  } else {
+    for (int i = 0; i < num_frames; ++i) {
+      LogFloor(mel + i * mel_stride, num_bins_);
+    }
+  }
+}
+
+void MelFilter(const float* weights, const int* offsets, int num_bins,
+               int width, const float* power, int power_stride,
+               int num_frames, float* mel, int mel_stride) {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+      FilterAvx2(weights, offsets, num_bins, width, power, power_stride,
+                 num_frames, mel, mel_stride);
+      break;
+    case SIMD_SSE2:
+      FilterSse2(weights, offsets, num_bins, width, power, power_stride,
+                 num_frames, mel, mel_stride);
+      break;
+#endif
+    default:
+      FilterScalar(weights, offsets, num_bins, width, power, power_stride,
+                   num_frames, mel, mel_stride);
+  }
+}
+
+void LogFloor(float* data, int n) {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+      LogFloorAvx2(data, n);
+      break;
+    case SIMD_SSE2:
+      LogFloorSse2(data, n);
+      break;
+#endif
+    default:
+      LogFloorScalar(data, n);
+  }
+}
+
+void LogEnergy(const float* power, int power_stride, int num_fft_bins,
+               int num_frames, float* log_energy) {
+  const float epsilon = std::numeric_limits<float>::epsilon();
+  for (int i = 0; i < num_frames; ++i) {
+    const float* row = power + i * power_stride;
+    // independent partial sums, which the compiler can keep in registers
+    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    int k = 0;
+    for (; k + 4 <= num_fft_bins; k += 4) {
+      sum[0] += row[k];
+      sum[1] += row[k + 1];
+      sum[2] += row[k + 2];
+      sum[3] += row[k + 3];
+    }
+    for (; k < num_fft_bins; ++k) sum[0] += row[k];
+    log_energy[i] = logf(std::max((sum[0] + sum[1]) + (sum[2] + sum[3]),
+                                  epsilon));
+  }
+}
+
+}  // namespace wenet
@@ -0,0 +1,76 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_MEL_BANKS_H_
+#define FRONTEND_MEL_BANKS_H_
+
+#include <utility>
+#include <vector>
+
+#include "utils/aligned_allocator.h"
+#include "utils/cpu_features.h"
+
+namespace wenet {
+
+// Mel filterbank stored as a dense banded matrix. Every triangle filter is
+// padded to the same width and kept in one contiguous aligned buffer together
+// with the first fft bin it covers, so that a block of frames can be filtered
+// as a small GEMM by the AVX2/SSE2 kernels. The kernel is chosen at runtime,
+// with a scalar fallback on other cpus.
+class MelBanks {
+ public:
+  // bins: first fft bin and the weights of each triangle filter.
+  // num_fft_bins: length of a power spectrum row.
+  MelBanks(const std::vector<std::pair<int, std::vector<float>>>& bins,
+           int num_fft_bins);
+
+  int num_bins() const { return num_bins_; }
+  int num_fft_bins() const { return num_fft_bins_; }
+
+  // Filter num_frames power spectra, row i starts at power + i * power_stride.
+  // The num_bins() energies of frame i are written to mel + i * mel_stride,
+  // optionally floored to epsilon and converted to log.
+  void Compute(const float* power, int power_stride, int num_frames,
+               bool use_log, float* mel, int mel_stride) const;
+
+ private:
+  int num_bins_;
+  int num_fft_bins_;
+  // padded filter width, a multiple of 8 for the simd kernels
+  int width_;
+  // first fft bin of each padded filter
+  std::vector<int> offsets_;
+  // num_bins_ x width_ filter weights
+  AlignedVector<float> weights_;
+  SimdLevel simd_level_;
+};
+
+// Banded filterbank kernel behind MelBanks::Compute(), for filter tables
+// built elsewhere. weights holds num_bins x width floats, 32 byte aligned,
+// width is a multiple of 8 and offsets[j] + width <= power_stride.
+void MelFilter(const float* weights, const int* offsets, int num_bins,
+               int width, const float* power, int power_stride,
+               int num_frames, float* mel, int mel_stride);
+
+// data[i] = log(max(data[i], epsilon)), vectorized.
+void LogFloor(float* data, int n);
+
+// log_energy[i] = log(max(sum of power row i, epsilon)) for num_frames rows
+// of num_fft_bins, row i starting at power + i * power_stride.
+void LogEnergy(const float* power, int power_stride, int num_fft_bins,
+               int num_frames, float* log_energy);
+
+}  // namespace wenet
+
+#endif  // FRONTEND_MEL_BANKS_H_
@@ -0,0 +1,66 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/multi_channel_pipeline.h"
+
+#include "frontend/pcm_convert.h"
+
+namespace wenet {
+
+MultiChannelPipeline::MultiChannelPipeline(const FeaturePipelineConfig& config)
+    : config_(config),
+      channels_(config.num_channels),
+      channel_ptrs_(config.num_channels) {
+  CHECK(config.num_channels >= 1);
+  config_.num_channels = 1;
+  config_.channel = 0;
+  for (int c = 0; c < config.num_channels; ++c) {
+    pipelines_.emplace_back(new FeaturePipeline(config_));
+  }
+}
+
+template <typename T>
+void MultiChannelPipeline::Accept(const T* wav, size_t num_samples) {
+  const int num_channels = this->num_channels();
+  CHECK(num_samples % num_channels == 0);
+  size_t num_frames = num_samples / num_channels;
+  for (int c = 0; c < num_channels; ++c) {
+    channels_[c].resize(num_frames);
+    channel_ptrs_[c] = channels_[c].data();
+  }
+  Deinterleave(wav, num_frames, num_channels, channel_ptrs_.data());
+  for (int c = 0; c < num_channels; ++c) {
+    pipelines_[c]->AcceptWaveform(channels_[c].data(), num_frames);
+  }
+}
+
+void MultiChannelPipeline::AcceptWaveform(const float* wav,
+                                          size_t num_samples) {
+  Accept(wav, num_samples);
+}
+
+void MultiChannelPipeline::AcceptWaveform(const int16_t* wav,
+                                          size_t num_samples) {
+  Accept(wav, num_samples);
+}
+
+void MultiChannelPipeline::set_input_finished() {
+  for (auto& pipeline : pipelines_) pipeline->set_input_finished();
+}
+
+void MultiChannelPipeline::Reset() {
+  for (auto& pipeline : pipelines_) pipeline->Reset();
+}
+
+}  // namespace wenet
@@ -0,0 +1,79 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_MULTI_CHANNEL_PIPELINE_H_
+#define FRONTEND_MULTI_CHANNEL_PIPELINE_H_
+
+#include <memory>
+#include <vector>
+
+#include "frontend/feature_pipeline.h"
+
+namespace wenet {
+
+// Independent feature pipelines of the channels of a multi-channel stream,
+// to run one spotter per channel. AcceptWaveform() deinterleaves every chunk
+// once and feeds each channel to its own pipeline, the features of channel c
+// are read from channel(c) as from a mono FeaturePipeline. The KwsStream of
+// each channel shares one KwsModel.
+//
+// To keep a single channel or to downmix them, set num_channels and channel
+// of a plain FeaturePipeline instead.
+class MultiChannelPipeline {
+ public:
+  // config.num_channels pipelines, config.channel is ignored.
+  explicit MultiChannelPipeline(const FeaturePipelineConfig& config);
+  // The pipelines reference config_, a copy or a move would leave them
+  // pointing at the source.
+  MultiChannelPipeline(const MultiChannelPipeline&) = delete;
+  MultiChannelPipeline& operator=(const MultiChannelPipeline&) = delete;
+
+  // wav holds interleaved frames, num_samples counts all their samples.
+  void AcceptWaveform(const float* wav, size_t num_samples);
+
+  void AcceptWaveform(const int16_t* wav, size_t num_samples);
+
+  void AcceptWaveform(const std::vector<float>& wav) {
+    AcceptWaveform(wav.data(), wav.size());
+  }
+
+  void AcceptWaveform(const std::vector<int16_t>& wav) {
+    AcceptWaveform(wav.data(), wav.size());
+  }
+
+  void set_input_finished();
+
+  void Reset();
+
+  int num_channels() const { return static_cast<int>(pipelines_.size()); }
+
+  FeaturePipeline* channel(int c) { return pipelines_[c].get(); }
+
+ private:
+  // Deinterleave the chunk, int16 samples are converted on the way, and
+  // feed every channel.
+  template <typename T>
+  void Accept(const T* wav, size_t num_samples);
+
+  // mono config of the channel pipelines, they keep a reference to it
+  FeaturePipelineConfig config_;
+  std::vector<std::unique_ptr<FeaturePipeline>> pipelines_;
+  // deinterleaved chunk, one buffer per channel
+  std::vector<std::vector<float>> channels_;
+  std::vector<float*> channel_ptrs_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_MULTI_CHANNEL_PIPELINE_H_
@@ -0,0 +1,284 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/pcm_convert.h"
+
+#include "utils/cpu_features.h"
+
+#ifdef WENET_X86
+#include <immintrin.h>
+#endif
+
+namespace wenet {
+
+namespace {
+
+void Int16ToFloatScalar(const int16_t* in, size_t n, float* out) {
+  for (size_t i = 0; i < n; ++i) out[i] = static_cast<float>(in[i]);
+}
+
+#ifdef WENET_X86
+
+void Int16ToFloatSse2(const int16_t* in, size_t n, float* out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    // sign extend by unpacking into the high halves and shifting back
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(out + i, _mm_cvtepi32_ps(lo));
+    _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(hi));
+  }
+  Int16ToFloatScalar(in + i, n - i, out + i);
+}
+
+#define WENET_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+WENET_TARGET_AVX2 void Int16ToFloatAvx2(const int16_t* in, size_t n,
+                                        float* out) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+    _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)));
+    _mm256_storeu_ps(out + i + 8,
+                     _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)));
+  }
+  Int16ToFloatSse2(in + i, n - i, out + i);
+}
+
+#endif  // WENET_X86
+
+template <typename T>
+void DeinterleaveScalar(const T* in, size_t num_frames, int num_channels,
+                        float* const* out, size_t offset = 0) {
+  for (size_t i = 0; i < num_frames; ++i) {
+    for (int c = 0; c < num_channels; ++c) {
+      out[c][offset + i] = static_cast<float>(in[i * num_channels + c]);
+    }
+  }
+}
+
+template <typename T>
+void SelectChannelScalar(const T* in, size_t num_frames, int num_channels,
+                         int channel, float* out) {
+  for (size_t i = 0; i < num_frames; ++i) {
+    out[i] = static_cast<float>(in[i * num_channels + channel]);
+  }
+}
+
+template <typename T>
+void DownmixScalar(const T* in, size_t num_frames, int num_channels,
+                   float* out) {
+  const float scale = 1.0f / num_channels;
+  for (size_t i = 0; i < num_frames; ++i) {
+    float sum = 0.0f;
+    for (int c = 0; c < num_channels; ++c) {
+      sum += static_cast<float>(in[i * num_channels + c]);
+    }
+    out[i] = sum * scale;
+  }
+}
+
+#ifdef WENET_X86
+
+// Load 8 samples as two vectors of 4 floats.
+inline void Load8(const float* in, __m128* a, __m128* b) {
+  *a = _mm_loadu_ps(in);
+  *b = _mm_loadu_ps(in + 4);
+}
+
+inline void Load8(const int16_t* in, __m128* a, __m128* b) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  *a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+  *b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+}
+
+// Load 4 frames of 2 channels as one vector per channel.
+template <typename T>
+inline void Load2(const T* in, __m128* c0, __m128* c1) {
+  __m128 a, b;
+  Load8(in, &a, &b);
+  *c0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  *c1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// Load 4 frames of 4 channels as one vector per channel.
+template <typename T>
+inline void Load4(const T* in, __m128* c) {
+  Load8(in, &c[0], &c[1]);
+  Load8(in + 8, &c[2], &c[3]);
+  _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+}
+
+template <typename T>
+void DeinterleaveSse2(const T* in, size_t num_frames, int num_channels,
+                      float* const* out) {
+  size_t i = 0;
+  if (num_channels == 2) {
+    for (; i + 4 <= num_frames; i += 4) {
+      __m128 c0, c1;
+      Load2(in + 2 * i, &c0, &c1);
+      _mm_storeu_ps(out[0] + i, c0);
+      _mm_storeu_ps(out[1] + i, c1);
+    }
+  } else if (num_channels == 4) {
+    for (; i + 4 <= num_frames; i += 4) {
+      __m128 c[4];
+      Load4(in + 4 * i, c);
+      for (int k = 0; k < 4; ++k) _mm_storeu_ps(out[k] + i, c[k]);
+    }
+  }
+  // the remaining frames, and all of them for other channel counts
+  DeinterleaveScalar(in + i * num_channels, num_frames - i, num_channels, out,
+                     i);
+}
+
+template <typename T>
+void SelectChannelSse2(const T* in, size_t num_frames, int num_channels,
+                       int channel, float* out) {
+  size_t i = 0;
+  if (num_channels == 2) {
+    for (; i + 4 <= num_frames; i += 4) {
+      __m128 c0, c1;
+      Load2(in + 2 * i, &c0, &c1);
+      _mm_storeu_ps(out + i, channel == 0 ? c0 : c1);
+    }
+  } else if (num_channels == 4) {
+    for (; i + 4 <= num_frames; i += 4) {
+      __m128 c[4];
+      Load4(in + 4 * i, c);
+      _mm_storeu_ps(out + i, c[channel]);
+    }
+  }
+  SelectChannelScalar(in + i * num_channels, num_frames - i, num_channels,
+                      channel, out + i);
+}
+
+template <typename T>
+void DownmixSse2(const T* in, size_t num_frames, int num_channels,
+                 float* out) {
+  size_t i = 0;
+  const __m128 scale = _mm_set1_ps(1.0f / num_channels);
+  if (num_channels == 2) {
+    for (; i + 4 <= num_frames; i += 4) {
+      __m128 c0, c1;
+      Load2(in + 2 * i, &c0, &c1);
+      _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(c0, c1), scale));
+    }
+  } else if (num_channels == 4) {
+    for (; i + 4 <= num_frames; i += 4) {
+      __m128 c[4];
+      Load4(in + 4 * i, c);
+      __m128 sum = _mm_add_ps(_mm_add_ps(c[0], c[1]), _mm_add_ps(c[2], c[3]));
+      _mm_storeu_ps(out + i, _mm_mul_ps(sum, scale));
+    }
+  }
+  DownmixScalar(in + i * num_channels, num_frames - i, num_channels, out + i);
+}
+
+#endif  // WENET_X86
+
+template <typename T>
+void DeinterleaveImpl(const T* in, size_t num_frames, int num_channels,
+                      float* const* out) {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+    case SIMD_SSE2:
+      DeinterleaveSse2(in, num_frames, num_channels, out);
+      break;
+#endif
+    default:
+      DeinterleaveScalar(in, num_frames, num_channels, out);
+  }
+}
+
+template <typename T>
+void SelectChannelImpl(const T* in, size_t num_frames, int num_channels,
+                       int channel, float* out) {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+    case SIMD_SSE2:
+      SelectChannelSse2(in, num_frames, num_channels, channel, out);
+      break;
+#endif
+    default:
+      SelectChannelScalar(in, num_frames, num_channels, channel, out);
+  }
+}
+
+template <typename T>
+void DownmixImpl(const T* in, size_t num_frames, int num_channels,
+                 float* out) {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+    case SIMD_SSE2:
+      DownmixSse2(in, num_frames, num_channels, out);
+      break;
+#endif
+    default:
+      DownmixScalar(in, num_frames, num_channels, out);
+  }
+}
+
+}  // namespace
+
+void Int16ToFloat(const int16_t* in, size_t n, float* out) {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+      Int16ToFloatAvx2(in, n, out);
+      break;
+    case SIMD_SSE2:
+      Int16ToFloatSse2(in, n, out);
+      break;
+#endif
+    default:
+      Int16ToFloatScalar(in, n, out);
+  }
+}
+
+void Deinterleave(const float* in, size_t num_frames, int num_channels,
+                  float* const* out) {
+  DeinterleaveImpl(in, num_frames, num_channels, out);
+}
+
+void Deinterleave(const int16_t* in, size_t num_frames, int num_channels,
+                  float* const* out) {
+  DeinterleaveImpl(in, num_frames, num_channels, out);
+}
+
+void SelectChannel(const float* in, size_t num_frames, int num_channels,
+                   int channel, float* out) {
+  SelectChannelImpl(in, num_frames, num_channels, channel, out);
+}
+
+void SelectChannel(const int16_t* in, size_t num_frames, int num_channels,
+                   int channel, float* out) {
+  SelectChannelImpl(in, num_frames, num_channels, channel, out);
+}
+
+void Downmix(const float* in, size_t num_frames, int num_channels, float* out) {
+  DownmixImpl(in, num_frames, num_channels, out);
+}
+
+void Downmix(const int16_t* in, size_t num_frames, int num_channels,
+             float* out) {
+  DownmixImpl(in, num_frames, num_channels, out);
+}
+
+}  // namespace wenet
@@ -0,0 +1,50 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_PCM_CONVERT_H_
+#define FRONTEND_PCM_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wenet {
+
+// out[i] = static_cast<float>(in[i]), vectorized. The samples keep the int16
+// scale, like the rest of the frontend expects.
+void Int16ToFloat(const int16_t* in, size_t n, float* out);
+
+// Multi-channel input holds num_frames frames of num_channels interleaved
+// samples. 2 and 4 channels are vectorized. The int16 versions convert the
+// samples on the way, like Int16ToFloat().
+
+// out[c][i] = in[i * num_channels + c]
+void Deinterleave(const float* in, size_t num_frames, int num_channels,
+                  float* const* out);
+void Deinterleave(const int16_t* in, size_t num_frames, int num_channels,
+                  float* const* out);
+
+// out[i] = in[i * num_channels + channel]
+void SelectChannel(const float* in, size_t num_frames, int num_channels,
+                   int channel, float* out);
+void SelectChannel(const int16_t* in, size_t num_frames, int num_channels,
+                   int channel, float* out);
+
+// out[i] = mean of the samples of frame i
+void Downmix(const float* in, size_t num_frames, int num_channels, float* out);
+void Downmix(const int16_t* in, size_t num_frames, int num_channels,
+             float* out);
+
+}  // namespace wenet
+
+#endif  // FRONTEND_PCM_CONVERT_H_
@@ -0,0 +1,220 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/resampler.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "utils/cpu_features.h"
+#include "utils/log.h"
+
+#ifdef WENET_X86
+#include <immintrin.h>
+#endif
+
+namespace wenet {
+
+namespace {
+
+// Zero crossings of the sinc on each side of the center, and the Kaiser
+// window shape. About 80 dB of stop band attenuation.
+const int kZeroCrossings = 16;
+const double kKaiserBeta = 8.0;
+// Cutoff relative to the lower of the two Nyquist frequencies.
+const double kRolloff = 0.95;
+
+int Gcd(int a, int b) {
+  while (b != 0) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// Modified Bessel function of the first kind, order 0.
+double BesselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 50; ++k) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+    if (term < sum * 1e-12) break;
+  }
+  return sum;
+}
+
+float DotScalar(const float* x, const float* h, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; ++i) sum += x[i] * h[i];
+  return sum;
+}
+
+#ifdef WENET_X86
+
+// n is a multiple of 8, h is aligned.
+float DotSse2(const float* x, const float* h, int n) {
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  for (int i = 0; i < n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_load_ps(h + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+                                       _mm_load_ps(h + i + 4)));
+  }
+  acc0 = _mm_add_ps(acc0, acc1);
+  acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+  acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+  return _mm_cvtss_f32(acc0);
+}
+
+#define WENET_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+WENET_TARGET_AVX2 float DotAvx2(const float* x, const float* h, int n) {
+  __m256 acc = _mm256_setzero_ps();
+  for (int i = 0; i < n; i += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_load_ps(h + i), acc);
+  }
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc),
+                          _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+#endif  // WENET_X86
+
+typedef float (*DotFunc)(const float* x, const float* h, int n);
+
+DotFunc GetDot() {
+  switch (GetSimdLevel()) {
+#ifdef WENET_X86
+    case SIMD_AVX2:
+      return DotAvx2;
+    case SIMD_SSE2:
+      return DotSse2;
+#endif
+    default:
+      return DotScalar;
+  }
+}
+
+}  // namespace
+
+ResamplerTables::ResamplerTables(int input_rate, int output_rate)
+    : input_rate_(input_rate), output_rate_(output_rate) {
+  CHECK(input_rate > 0 && output_rate > 0);
+  int g = Gcd(input_rate, output_rate);
+  up_ = output_rate / g;
+  down_ = input_rate / g;
+  // cutoff in cycles per input sample, and half width of the filter in
+  // input samples
+  double cutoff = 0.5 * kRolloff * std::min(1.0, static_cast<double>(up_) / down_);
+  double half_width = kZeroCrossings / (2.0 * cutoff);
+  num_taps_ = 2 * static_cast<int>(ceil(half_width));
+  num_taps_ = (num_taps_ + 7) / 8 * 8;
+  filters_.assign(static_cast<size_t>(up_) * num_taps_, 0.0f);
+  double i0_beta = BesselI0(kKaiserBeta);
+  for (int p = 0; p < up_; ++p) {
+    // fractional part of the output position of this phase
+    double frac = static_cast<double>(p) / up_;
+    float* h = filters_.data() + p * num_taps_;
+    double sum = 0.0;
+    for (int j = 0; j < num_taps_; ++j) {
+      // distance from the output position to input sample
+      // i - num_taps / 2 + 1 + j
+      double t = j - num_taps_ / 2 + 1 - frac;
+      if (fabs(t) >= half_width) continue;
+      double x = 2.0 * cutoff * t;
+      double sinc = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+      double r = t / half_width;
+      double window = BesselI0(kKaiserBeta * sqrt(1.0 - r * r)) / i0_beta;
+      h[j] = sinc * window;
+      sum += h[j];
+    }
+    // unit gain at dc for every phase
+    for (int j = 0; j < num_taps_; ++j) h[j] /= sum;
+  }
+}
+
+std::shared_ptr<const ResamplerTables> ResamplerTables::Get(int input_rate,
+                                                            int output_rate) {
+  typedef std::pair<int, int> Key;
+  static std::mutex mutex;
+  static std::map<Key, std::weak_ptr<const ResamplerTables>> cache;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::weak_ptr<const ResamplerTables>& entry =
+      cache[Key(input_rate, output_rate)];
+  std::shared_ptr<const ResamplerTables> tables = entry.lock();
+  if (tables == nullptr) {
+    tables = std::make_shared<const ResamplerTables>(input_rate, output_rate);
+    entry = tables;
+  }
+  return tables;
+}
+
+Resampler::Resampler(int input_rate, int output_rate)
+    : tables_(ResamplerTables::Get(input_rate, output_rate)) {
+  Reset();
+}
+
+void Resampler::Reset() {
+  // The input before the stream start is silence, so that the first output
+  // sample is aligned with the first input sample.
+  int history = tables_->num_taps() / 2 - 1;
+  buffer_.assign(history, 0.0f);
+  base_ = -history;
+  next_ = 0;
+}
+
+void Resampler::Accept(const float* samples, int n) {
+  memcpy(BeginAccept(n), samples, sizeof(float) * n);
+}
+
+float* Resampler::BeginAccept(int n) {
+  size_t size = buffer_.size();
+  buffer_.resize(size + n);
+  return buffer_.data() + size;
+}
+
+int Resampler::Read(float* out, int max_out) {
+  static const DotFunc dot = GetDot();
+  const int up = tables_->up(), down = tables_->down();
+  const int num_taps = tables_->num_taps();
+  const int64_t end = base_ + static_cast<int64_t>(buffer_.size());
+  int n = 0;
+  for (; n < max_out; ++n) {
+    int64_t pos = next_ * down;
+    int64_t i = pos / up;
+    // first input sample of the filter, it needs num_taps of them
+    int64_t first = i - num_taps / 2 + 1;
+    if (first + num_taps > end) break;
+    out[n] = dot(buffer_.data() + (first - base_),
+                 tables_->phase(static_cast<int>(pos % up)), num_taps);
+    ++next_;
+  }
+  // Drop the input that no later output needs.
+  int64_t first = next_ * down / up - num_taps / 2 + 1;
+  int64_t drop = std::min(first - base_, static_cast<int64_t>(buffer_.size()));
+  if (drop > 0) {
+    buffer_.erase(buffer_.begin(), buffer_.begin() + drop);
+    base_ += drop;
+  }
+  return n;
+}
+
+}  // namespace wenet
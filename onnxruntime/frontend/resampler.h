@@ -0,0 +1,89 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_RESAMPLER_H_
+#define FRONTEND_RESAMPLER_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "utils/aligned_allocator.h"
+
+namespace wenet {
+
+// Polyphase filter bank converting input_rate to output_rate. With
+// output_rate / input_rate = L / M in lowest terms, output sample n sits at
+// input position n * M / L, and phase (n * M) % L holds the windowed sinc
+// taps of that fractional delay. The tables only depend on the two rates,
+// they are built once per ratio and shared through Get().
+class ResamplerTables {
+ public:
+  ResamplerTables(int input_rate, int output_rate);
+
+  // Shared tables of a ratio, cached weakly. Thread safe.
+  static std::shared_ptr<const ResamplerTables> Get(int input_rate,
+                                                    int output_rate);
+
+  int input_rate() const { return input_rate_; }
+  int output_rate() const { return output_rate_; }
+  // output_rate / input_rate = up() / down()
+  int up() const { return up_; }
+  int down() const { return down_; }
+  // taps per phase, a multiple of 8
+  int num_taps() const { return num_taps_; }
+  // Taps of phase p, applied to input samples [i - num_taps / 2 + 1,
+  // i + num_taps / 2] where i is the integer part of the output position.
+  const float* phase(int p) const { return filters_.data() + p * num_taps_; }
+
+ private:
+  int input_rate_;
+  int output_rate_;
+  int up_;
+  int down_;
+  int num_taps_;
+  AlignedVector<float> filters_;
+};
+
+// Streaming sample rate converter in front of the framer. Input is buffered
+// with the history the filter needs, output is produced on demand, so a
+// caller can write it straight into its own buffer. The state is kept
+// across chunks, the result does not depend on how the input is chunked.
+class Resampler {
+ public:
+  Resampler(int input_rate, int output_rate);
+
+  // Append n input samples.
+  void Accept(const float* samples, int n);
+
+  // Destination of the next n input samples, to write them in place.
+  float* BeginAccept(int n);
+
+  // Write up to max_out output samples to out, return their number.
+  int Read(float* out, int max_out);
+
+  void Reset();
+
+ private:
+  std::shared_ptr<const ResamplerTables> tables_;
+  // pending input, buffer_[0] is input sample base_
+  std::vector<float> buffer_;
+  int64_t base_;
+  // next output sample
+  int64_t next_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_RESAMPLER_H_
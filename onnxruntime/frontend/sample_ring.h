@@ -0,0 +1,98 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_SAMPLE_RING_H_
+#define FRONTEND_SAMPLE_RING_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "utils/aligned_allocator.h"
+#include "utils/log.h"
+
+namespace wenet {
+
+// Persistent ring buffer of waveform samples used to frame the streaming
+// input. Every sample is stored twice, at i and i + capacity, so the pending
+// samples are always one contiguous span and frames are computed in place,
+// whatever the chunk sizes are. The buffer is allocated once.
+class SampleRing {
+ public:
+  // capacity is rounded up to a power of two and must hold one frame.
+  SampleRing(int capacity, int frame_length) : read_(0), size_(0) {
+    capacity_ = 1;
+    while (capacity_ < capacity) capacity_ <<= 1;
+    CHECK(capacity_ > frame_length);
+    buffer_.resize(2 * capacity_, 0.0f);
+  }
+
+  int capacity() const { return capacity_; }
+
+  // Number of pending samples.
+  int size() const { return size_; }
+
+  // Number of samples that can be written before some are consumed.
+  int space() const { return capacity_ - size_; }
+
+  // Pending samples, size() floats.
+  const float* data() const { return buffer_.data() + read_; }
+
+  // Append n <= space() samples.
+  void Write(const float* samples, int n) {
+    memcpy(BeginWrite(n), samples, sizeof(float) * n);
+    CommitWrite(n);
+  }
+
+  // Contiguous destination of the next n <= space() samples, they become
+  // pending after CommitWrite(n).
+  float* BeginWrite(int n) {
+    CHECK(n <= space());
+    return buffer_.data() + ((read_ + size_) & (capacity_ - 1));
+  }
+
+  void CommitWrite(int n) {
+    int pos = (read_ + size_) & (capacity_ - 1);
+    float* base = buffer_.data();
+    // The samples were written at pos.. pos + n, which may run into the
+    // mirror half. Copy them to the other half so both views agree.
+    int first = std::min(n, capacity_ - pos);
+    memcpy(base + pos + capacity_, base + pos, sizeof(float) * first);
+    if (first < n) {
+      memcpy(base, base + capacity_, sizeof(float) * (n - first));
+    }
+    size_ += n;
+  }
+
+  // Drop the n oldest pending samples.
+  void Consume(int n) {
+    CHECK(n <= size_);
+    read_ = (read_ + n) & (capacity_ - 1);
+    size_ -= n;
+  }
+
+  void Clear() {
+    read_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  int capacity_;
+  int read_;
+  int size_;
+  AlignedVector<float> buffer_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_SAMPLE_RING_H_
@@ -0,0 +1,74 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frontend/vad.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace wenet {
+
+namespace {
+
+// log(geometric mean) - log(arithmetic mean) of the mel energies.
+float SpectralFlatness(const float* log_mel, int num_bins) {
+  float sum = 0.0f, max = log_mel[0];
+  for (int i = 0; i < num_bins; ++i) {
+    sum += log_mel[i];
+    max = std::max(max, log_mel[i]);
+  }
+  float exp_sum = 0.0f;
+  for (int i = 0; i < num_bins; ++i) exp_sum += expf(log_mel[i] - max);
+  return sum / num_bins - (max + logf(exp_sum / num_bins));
+}
+
+}  // namespace
+
+Vad::Vad(const VadConfig& config) : config_(config) { Reset(); }
+
+void Vad::Reset() {
+  has_floor_ = false;
+  noise_floor_ = 0.0f;
+  hangover_ = 0;
+}
+
+void Vad::Process(const float* log_mel, int num_bins, const float* log_energy,
+                  int num_frames, uint8_t* speech) {
+  for (int i = 0; i < num_frames; ++i) {
+    float energy = log_energy[i];
+    if (!has_floor_) {
+      noise_floor_ = energy;
+      has_floor_ = true;
+    }
+    bool active = energy > noise_floor_ + config_.energy_margin &&
+                  energy > config_.min_energy &&
+                  SpectralFlatness(log_mel + i * num_bins, num_bins) <
+                      config_.max_flatness;
+    // The floor follows the energy down quickly and up slowly, so speech
+    // barely raises it.
+    float rate =
+        energy < noise_floor_ ? config_.floor_down_rate : config_.floor_up_rate;
+    noise_floor_ += rate * (energy - noise_floor_);
+    if (active) {
+      hangover_ = config_.hangover_frames;
+    } else if (hangover_ > 0) {
+      --hangover_;
+      active = true;
+    }
+    speech[i] = active ? 1 : 0;
+  }
+}
+
+}  // namespace wenet
@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRONTEND_VAD_H_
+#define FRONTEND_VAD_H_
+
+#include <cstdint>
+
+namespace wenet {
+
+struct VadConfig {
+  // A frame is speech when its log energy is energy_margin above the noise
+  // floor (2.0 ~ 8.7 dB) and above min_energy, which rejects digital
+  // silence, ...
+  float energy_margin = 2.0f;
+  float min_energy = 12.0f;
+  // ... and when its log-mel spectral flatness, log(geometric mean) -
+  // log(arithmetic mean) of the mel energies, is below max_flatness. It is
+  // close to 0 for white noise and strongly negative for voiced speech.
+  float max_flatness = -0.5f;
+  // Frames still marked as speech after the last speech frame.
+  int hangover_frames = 30;
+  // Frames before a speech onset run through the model as well, so that
+  // it sees the onset from a warm cache. FeaturePipeline::Read() holds
+  // them back until the frames after them are marked.
+  int pre_roll_frames = 20;
+  // Smoothing of the noise floor, when it falls and when it rises.
+  float floor_down_rate = 0.2f;
+  float floor_up_rate = 0.002f;
+};
+
+// Energy and spectral flatness voice activity detector. It works on the log
+// energies and log-mel energies that the fbank already computes, and tracks
+// an adaptive noise floor.
+class Vad {
+ public:
+  explicit Vad(const VadConfig& config = VadConfig());
+
+  // Mark num_frames frames, log_mel holds num_frames rows of num_bins log
+  // mel energies and log_energy their log energies. speech[i] is 1 for
+  // speech or hangover frames, 0 otherwise.
+  void Process(const float* log_mel, int num_bins, const float* log_energy,
+               int num_frames, uint8_t* speech);
+
+  void Reset();
+
+ private:
+  VadConfig config_;
+  bool has_floor_;
+  float noise_floor_;
+  // hangover frames left
+  int hangover_;
+};
+
+}  // namespace wenet
+
+#endif  // FRONTEND_VAD_H_
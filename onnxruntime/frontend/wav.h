@@ -22,9 +22,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <limits>
 #include <string>
+#include <vector>
 
+#include "frontend/pcm_convert.h"
+#include "utils/aligned_allocator.h"
 #include "utils/log.h"
+#include "utils/mapped_file.h"
 
 namespace wenet {
 
@@ -44,75 +50,137 @@ struct WavHeader {
   unsigned int data_size;
 };
 
+// Little endian fields of the RIFF chunks.
+inline uint16_t ReadUint16(const char* p) {
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t ReadUint32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Sample format of a wav file, from its "fmt " chunk.
+struct WavFormat {
+  int num_channel = 0;
+  int sample_rate = 0;
+  int bits_per_sample = 0;
+
+  // Parse a fmt chunk of chunk_size bytes, return false if the samples are
+  // not PCM of 8, 16 or 32 bits.
+  bool Parse(const char* chunk, size_t chunk_size) {
+    if (chunk_size < 16) return false;
+    int format = ReadUint16(chunk);
+    num_channel = ReadUint16(chunk + 2);
+    sample_rate = ReadUint32(chunk + 4);
+    bits_per_sample = ReadUint16(chunk + 14);
+    // WAVE_FORMAT_EXTENSIBLE, the format is in the sub format guid
+    if (format == 0xFFFE && chunk_size >= 26) format = ReadUint16(chunk + 24);
+    return format == 1 && num_channel > 0 &&
+           (bits_per_sample == 8 || bits_per_sample == 16 ||
+            bits_per_sample == 32);
+  }
+
+  // bytes of one frame of samples
+  int block_size() const { return num_channel * (bits_per_sample / 8); }
+};
+
+// Convert n samples of bits_per_sample bits to float, with the scale of
+// their integer type. 16 bits samples must be aligned.
+inline void PcmToFloat(const char* pcm, size_t n, int bits_per_sample,
+                       float* out) {
+  switch (bits_per_sample) {
+    case 8:
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<float>(static_cast<char>(pcm[i]));
+      }
+      break;
+    case 16:
+      Int16ToFloat(reinterpret_cast<const int16_t*>(pcm), n, out);
+      break;
+    case 32:
+      for (size_t i = 0; i < n; ++i) {
+        int32_t sample;
+        memcpy(&sample, pcm + i * sizeof(sample), sizeof(sample));
+        out[i] = static_cast<float>(sample);
+      }
+      break;
+  }
+}
+
+// Reader of PCM wav files. The file is memory mapped and its RIFF chunks
+// are parsed once, the samples are not copied: int16_data() is a view of the
+// 16 bits samples in the mapping, and data() converts all of them to float
+// in bulk on its first call only. See ChunkedWavReader to stream long files
+// with bounded memory.
 class WavReader {
  public:
-  WavReader() : data_(nullptr) {}
+  WavReader() { Clear(); }
   explicit WavReader(const std::string& filename) { Open(filename); }
 
   bool Open(const std::string& filename) {
-    FILE* fp = fopen(filename.c_str(), "rb");
-    if (NULL == fp) {
+    Clear();
+    if (!file_.Open(filename)) {
       LOG(WARNING) << "Error in read " << filename;
       return false;
     }
-
-    WavHeader header;
-    fread(&header, 1, sizeof(header), fp);
-    if (header.fmt_size < 16) {
-      fprintf(stderr,
-              "WaveData: expect PCM format data "
-              "to have fmt chunk of at least size 16.\n");
+    const char* file = file_.data();
+    const size_t file_size = file_.size();
+    if (file_size < 12 || memcmp(file, "RIFF", 4) != 0 ||
+        memcmp(file + 8, "WAVE", 4) != 0) {
+      LOG(WARNING) << filename << " is not a RIFF WAVE file";
       return false;
-    } else if (header.fmt_size > 16) {
-      int offset = 44 - 8 + header.fmt_size - 16;
-      fseek(fp, offset, SEEK_SET);
-      fread(header.data, 8, sizeof(char), fp);
-    }
-    // check "riff" "WAVE" "fmt " "data"
-
-    // Skip any subchunks between "fmt" and "data".  Usually there will
-    // be a single "fact" subchunk, but on Windows there can also be a
-    // "list" subchunk.
-    while (0 != strncmp(header.data, "data", 4)) {
-      // We will just ignore the data in these chunks.
-      fseek(fp, header.data_size, SEEK_CUR);
-      // read next subchunk
-      fread(header.data, 8, sizeof(char), fp);
     }
-
-    num_channel_ = header.channels;
-    sample_rate_ = header.sample_rate;
-    bits_per_sample_ = header.bit;
-    int num_data = header.data_size / (bits_per_sample_ / 8);
-    data_ = new float[num_data];
-    num_samples_ = num_data / num_channel_;
-
-    for (int i = 0; i < num_data; ++i) {
-      switch (bits_per_sample_) {
-        case 8: {
-          char sample;
-          fread(&sample, 1, sizeof(char), fp);
-          data_[i] = static_cast<float>(sample);
-          break;
+    // Walk the chunks, usually "fmt " then "data" with maybe a "fact" or
+    // "LIST" chunk between them, they are skipped.
+    WavFormat format;
+    bool has_fmt = false;
+    const char* pcm = nullptr;
+    size_t pcm_size = 0;
+    size_t pos = 12;
+    while (pos + 8 <= file_size && pcm == nullptr) {
+      const char* chunk = file + pos + 8;
+      size_t chunk_size = ReadUint32(file + pos + 4);
+      size_t available = file_size - pos - 8;
+      if (memcmp(file + pos, "fmt ", 4) == 0) {
+        if (chunk_size > available ||
+            !format.Parse(chunk, chunk_size)) {
+          LOG(WARNING) << filename << ": unsupported fmt chunk, "
+                       << format.num_channel << " channels, "
+                       << format.bits_per_sample << " bits";
+          return false;
         }
-        case 16: {
-          int16_t sample;
-          fread(&sample, 1, sizeof(int16_t), fp);
-          data_[i] = static_cast<float>(sample);
-          break;
-        }
-        case 32: {
-          int sample;
-          fread(&sample, 1, sizeof(int), fp);
-          data_[i] = static_cast<float>(sample);
-          break;
-        }
-        default:
-          fprintf(stderr, "unsupported quantization bits");
-          exit(1);
+        has_fmt = true;
+      } else if (memcmp(file + pos, "data", 4) == 0) {
+        // a truncated file keeps the samples it has
+        pcm = chunk;
+        pcm_size = std::min(chunk_size, available);
+      }
+      // chunks are padded to an even size
+      pos += 8 + chunk_size + (chunk_size & 1);
+    }
+    if (!has_fmt || pcm == nullptr) {
+      LOG(WARNING) << filename << ": no fmt or data chunk";
+      return false;
+    }
+    num_channel_ = format.num_channel;
+    sample_rate_ = format.sample_rate;
+    bits_per_sample_ = format.bits_per_sample;
+    num_samples_ = pcm_size / format.block_size();
+    pcm_ = pcm;
+    if (bits_per_sample_ == 16) {
+      if (reinterpret_cast<uintptr_t>(pcm_) % sizeof(int16_t) == 0) {
+        int16_data_ = reinterpret_cast<const int16_t*>(pcm_);
+      } else {
+        // odd chunk offset of a malformed file, copy to align the samples
+        int16_copy_.resize(num_samples_ * num_channel_);
+        memcpy(int16_copy_.data(), pcm_, int16_copy_.size() * sizeof(int16_t));
+        int16_data_ = int16_copy_.data();
       }
     }
-    fclose(fp);
     return true;
   }
 
@@ -121,21 +189,167 @@ class WavReader {
   int bits_per_sample() const { return bits_per_sample_; }
   int num_samples() const { return num_samples_; }
 
-  ~WavReader() {
-    if (data_ != NULL) delete[] data_;
-  }
-
-  const float* data() const { return data_; }
-
-
+  // num_samples() * num_channel() interleaved 16 bits samples in place, null
+  // for other sample sizes.
+  const int16_t* int16_data() const { return int16_data_; }
 
+  // The samples as float, with the scale of their integer type. They are
+  // converted on the first call.
+  const float* data() const {
+    if (pcm_ != nullptr && float_data_.empty()) {
+      size_t n = static_cast<size_t>(num_samples_) * num_channel_;
+      float_data_.resize(n);
+      const char* pcm = bits_per_sample_ == 16
+                            ? reinterpret_cast<const char*>(int16_data_)
+                            : pcm_;
+      PcmToFloat(pcm, n, bits_per_sample_, float_data_.data());
+    }
+    return float_data_.data();
+  }
 
  private:
+  void Clear() {
+    file_.Close();
+    num_channel_ = sample_rate_ = bits_per_sample_ = num_samples_ = 0;
+    pcm_ = nullptr;
+    int16_data_ = nullptr;
+    int16_copy_.clear();
+    float_data_.clear();
+  }
+
+  MappedFile file_;
   int num_channel_;
   int sample_rate_;
   int bits_per_sample_;
   int num_samples_;  // sample points per channel
-  float* data_;
+  // samples of the data chunk in file_
+  const char* pcm_;
+  const int16_t* int16_data_;
+  std::vector<int16_t> int16_copy_;
+  // converted on demand by data()
+  mutable AlignedVector<float> float_data_;
+};
+
+// Pull reader of a wav or raw pcm file, block by block. Only the header is
+// read by Open(), each Next() reads the following samples, so the memory
+// does not depend on the file length, e.g. to scan hours long recordings:
+//
+//   std::vector<float> block(1600);
+//   size_t n;
+//   while ((n = reader.Next(block.data(), block.size())) > 0) {
+//     feature_pipeline.AcceptWaveform(block.data(), n);
+//   }
+class ChunkedWavReader {
+ public:
+  ChunkedWavReader() : fp_(nullptr), remaining_(0) {}
+  ~ChunkedWavReader() { Close(); }
+
+  ChunkedWavReader(const ChunkedWavReader&) = delete;
+  ChunkedWavReader& operator=(const ChunkedWavReader&) = delete;
+
+  // Open a wav file and read its header, up to the data chunk.
+  bool Open(const std::string& filename) {
+    if (!OpenFile(filename)) return false;
+    char header[12];
+    if (fread(header, 1, 12, fp_) != 12 || memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0) {
+      LOG(WARNING) << filename << " is not a RIFF WAVE file";
+      Close();
+      return false;
+    }
+    bool has_fmt = false;
+    char chunk_header[8];
+    while (fread(chunk_header, 1, 8, fp_) == 8) {
+      size_t chunk_size = ReadUint32(chunk_header + 4);
+      if (memcmp(chunk_header, "fmt ", 4) == 0) {
+        // A fmt chunk is at most 40 bytes, its size is not trusted to
+        // allocate.
+        char chunk[64];
+        if (chunk_size > sizeof(chunk) ||
+            fread(chunk, 1, chunk_size, fp_) != chunk_size ||
+            !format_.Parse(chunk, chunk_size)) {
+          LOG(WARNING) << filename << ": unsupported fmt chunk, "
+                       << format_.num_channel << " channels, "
+                       << format_.bits_per_sample << " bits";
+          break;
+        }
+        has_fmt = true;
+        if (chunk_size & 1) fseek(fp_, 1, SEEK_CUR);
+      } else if (memcmp(chunk_header, "data", 4) == 0) {
+        if (!has_fmt) break;
+        // The header may overstate the size of a truncated or still
+        // growing file, Next() stops at its end anyway.
+        remaining_ = chunk_size / format_.block_size() * format_.block_size();
+        return true;
+      } else {
+        fseek(fp_, chunk_size + (chunk_size & 1), SEEK_CUR);
+      }
+    }
+    LOG(WARNING) << filename << ": no fmt or data chunk";
+    Close();
+    return false;
+  }
+
+  // Open a raw pcm file, 16 bits little endian samples.
+  bool OpenPcm(const std::string& filename, int sample_rate = 16000,
+               int num_channel = 1) {
+    if (!OpenFile(filename)) return false;
+    format_.num_channel = num_channel;
+    format_.sample_rate = sample_rate;
+    format_.bits_per_sample = 16;
+    remaining_ = std::numeric_limits<size_t>::max();
+    return true;
+  }
+
+  int num_channel() const { return format_.num_channel; }
+  int sample_rate() const { return format_.sample_rate; }
+  int bits_per_sample() const { return format_.bits_per_sample; }
+
+  // Read up to max_samples samples to out, interleaved when there are
+  // several channels, and return their number, always whole frames. 0 at
+  // the end of the file.
+  size_t Next(float* out, size_t max_samples) {
+    if (fp_ == nullptr) return 0;
+    const int block_size = format_.block_size();
+    const int sample_size = format_.bits_per_sample / 8;
+    size_t bytes = max_samples / format_.num_channel * block_size;
+    bytes = std::min(bytes, remaining_);
+    if (bytes == 0) return 0;
+    buffer_.resize((bytes + sizeof(int32_t) - 1) / sizeof(int32_t));
+    bytes = fread(buffer_.data(), 1, bytes, fp_);
+    bytes = bytes / block_size * block_size;
+    remaining_ -= bytes;
+    if (bytes == 0) remaining_ = 0;
+    size_t n = bytes / sample_size;
+    PcmToFloat(reinterpret_cast<const char*>(buffer_.data()), n,
+               format_.bits_per_sample, out);
+    return n;
+  }
+
+  void Close() {
+    if (fp_ != nullptr) fclose(fp_);
+    fp_ = nullptr;
+    remaining_ = 0;
+  }
+
+ private:
+  bool OpenFile(const std::string& filename) {
+    Close();
+    format_ = WavFormat();
+    fp_ = fopen(filename.c_str(), "rb");
+    if (fp_ == nullptr) {
+      LOG(WARNING) << "Error in read " << filename;
+      return false;
+    }
+    return true;
+  }
+
+  FILE* fp_;
+  WavFormat format_;
+  // bytes left in the data chunk
+  size_t remaining_;
+  // raw samples of one Next() call, int32_t keeps them aligned
+  std::vector<int32_t> buffer_;
 };
 
 class WavWriter {
@@ -0,0 +1,177 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "kws/batch_engine.h"
+
+#include <string.h>
+
+#include <stdexcept>
+#include <utility>
+
+#include "utils/log.h"
+
+namespace wekws {
+
+    BatchEngine::BatchEngine(std::shared_ptr<const KwsModel> model,
+                             const BatchEngineConfig &config)
+            : model_(std::move(model)), config_(config) {
+        CHECK(config_.max_batch_size > 0 && config_.max_wait_ms >= 0);
+        if (model_->session() == nullptr) {
+            throw std::runtime_error("BatchEngine runs onnx models only, not a native net");
+        }
+        in_names_ = {"input", "cache"};
+        out_names_ = {"output", "r_cache"};
+        // a model exported with a fixed batch of 1 cannot be stacked
+        Ort::Session *session = model_->session();
+        int64_t batch_dim = session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape()[0];
+        if (batch_dim > 0 && config_.max_batch_size > batch_dim) {
+            LOG(WARNING) << "The model has a fixed batch size of " << batch_dim
+                         << ", re-export it with a dynamic batch axis";
+            config_.max_batch_size = static_cast<int>(batch_dim);
+        }
+        memory_info_ = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+        binding_.reset(new Ort::IoBinding(*session));
+        worker_ = std::thread(&BatchEngine::Loop, this);
+    }
+
+    BatchEngine::~BatchEngine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        queued_.notify_one();
+        worker_.join();
+    }
+
+    void BatchEngine::Forward(const wenet::FeatureView &feats,
+                              const float *cache, float *r_cache,
+                              float *output) {
+        if (feats.empty()) return;
+        Request request{feats, cache, r_cache, output,
+                        std::chrono::steady_clock::now(), false, nullptr};
+        std::unique_lock<std::mutex> lock(mutex_);
+        CHECK(!stop_);
+        queue_.push_back(&request);
+        queued_.notify_one();
+        done_.wait(lock, [&request] { return request.done; });
+        if (request.error != nullptr) std::rethrow_exception(request.error);
+    }
+
+    void BatchEngine::NextBatch(std::vector<Request *> *batch) {
+        batch->clear();
+        std::unique_lock<std::mutex> lock(mutex_);
+        queued_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        // Give the other streams until the deadline of the oldest chunk to
+        // fill the batch, no wait once it is full or on shutdown.
+        const size_t max_batch_size = config_.max_batch_size;
+        const auto deadline = queue_.front()->arrival +
+                              std::chrono::milliseconds(config_.max_wait_ms);
+        queued_.wait_until(lock, deadline, [this, max_batch_size] {
+            return stop_ || queue_.size() >= max_batch_size;
+        });
+        // The oldest chunk and the following ones of the same length, the
+        // others wait for a later batch.
+        const int num_frames = queue_.front()->feats.num_rows();
+        const int feature_dim = queue_.front()->feats.num_cols();
+        for (auto it = queue_.begin();
+             it != queue_.end() && batch->size() < max_batch_size;) {
+            if ((*it)->feats.num_rows() == num_frames &&
+                (*it)->feats.num_cols() == feature_dim) {
+                batch->push_back(*it);
+                it = queue_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void BatchEngine::RunBatch(const std::vector<Request *> &batch) {
+        const int64_t batch_size = batch.size();
+        const int num_frames = batch[0]->feats.num_rows();
+        const int feature_dim = batch[0]->feats.num_cols();
+        const size_t feats_size = static_cast<size_t>(num_frames) * feature_dim;
+        const int output_dim = model_->output_dim();
+        const size_t output_size = static_cast<size_t>(num_frames) * output_dim;
+        const size_t cache_size = model_->cache_size();
+        // 1. Gather, each stream is one contiguous slice of the stacked
+        // tensors along the batch axis.
+        if (feats_.size() < batch_size * feats_size) feats_.resize(batch_size * feats_size);
+        if (cache_.size() < batch_size * cache_size) {
+            cache_.resize(batch_size * cache_size);
+            r_cache_.resize(batch_size * cache_size);
+        }
+        if (output_.size() < batch_size * output_size) output_.resize(batch_size * output_size);
+        for (int64_t b = 0; b < batch_size; b++) {
+            memcpy(feats_.data() + b * feats_size, batch[b]->feats.data(),
+                   sizeof(float) * feats_size);
+            memcpy(cache_.data() + b * cache_size, batch[b]->cache,
+                   sizeof(float) * cache_size);
+        }
+        // 2. Run the whole batch at once.
+        const int64_t feats_shape[3] = {batch_size, num_frames, feature_dim};
+        const int64_t output_shape[3] = {batch_size, num_frames, output_dim};
+        std::vector<int64_t> cache_shape(model_->cache_shape());
+        cache_shape[0] = batch_size;
+        Ort::Value feats_ort = Ort::Value::CreateTensor<float>(
+                memory_info_, feats_.data(), batch_size * feats_size,
+                feats_shape, 3);
+        Ort::Value cache_ort = Ort::Value::CreateTensor<float>(
+                memory_info_, cache_.data(), batch_size * cache_size,
+                cache_shape.data(), cache_shape.size());
+        Ort::Value r_cache_ort = Ort::Value::CreateTensor<float>(
+                memory_info_, r_cache_.data(), batch_size * cache_size,
+                cache_shape.data(), cache_shape.size());
+        Ort::Value output_ort = Ort::Value::CreateTensor<float>(
+                memory_info_, output_.data(), batch_size * output_size,
+                output_shape, 3);
+        binding_->BindInput(in_names_[0], feats_ort);
+        binding_->BindInput(in_names_[1], cache_ort);
+        binding_->BindOutput(out_names_[0], output_ort);
+        binding_->BindOutput(out_names_[1], r_cache_ort);
+        model_->session()->Run(Ort::RunOptions{nullptr}, *binding_);
+        // 3. Scatter the output rows and new cache back to each stream.
+        for (int64_t b = 0; b < batch_size; b++) {
+            memcpy(batch[b]->output, output_.data() + b * output_size,
+                   sizeof(float) * output_size);
+            memcpy(batch[b]->r_cache, r_cache_.data() + b * cache_size,
+                   sizeof(float) * cache_size);
+        }
+    }
+
+    void BatchEngine::Loop() {
+        std::vector<Request *> batch;
+        while (true) {
+            NextBatch(&batch);
+            if (batch.empty()) break;
+            // A failed run must still wake its streams, they rethrow.
+            std::exception_ptr error;
+            try {
+                RunBatch(batch);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (Request *request : batch) {
+                    request->error = error;
+                    request->done = true;
+                }
+            }
+            done_.notify_all();
+        }
+    }
+
+}  // namespace wekws
@@ -0,0 +1,114 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KWS_BATCH_ENGINE_H_
+#define KWS_BATCH_ENGINE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "onnxruntime_cxx_api.h"  // NOLINT
+#include "frontend/feature_matrix.h"
+#include "kws/kws_model.h"
+
+namespace wekws {
+
+    struct BatchEngineConfig {
+        // most chunks stacked in one run
+        int max_batch_size = 16;
+        // longest time the oldest queued chunk waits for others to join its
+        // batch, in milliseconds
+        int max_wait_ms = 5;
+    };
+
+    // Runs the chunks of many streams of one model as batches: the queued
+    // chunks with the same number of frames are stacked into one
+    // [B, T, D] input and [B, cache_dim, cache_len(, 4)] cache, run at once,
+    // and the output rows and r_cache of each are scattered back to their
+    // stream. The model must be an onnx one exported with a dynamic batch
+    // axis, not a native net.
+    // KwsStream::set_batch_engine() routes the streams through it.
+    class BatchEngine {
+    public:
+        explicit BatchEngine(std::shared_ptr<const KwsModel> model,
+                             const BatchEngineConfig &config = BatchEngineConfig());
+        ~BatchEngine();
+
+        BatchEngine(const BatchEngine &) = delete;
+        BatchEngine &operator=(const BatchEngine &) = delete;
+
+        // Forward one chunk of a stream, blocking until its batch is run.
+        // cache is read and the new cache written to r_cache, both of
+        // cache_size() floats. output receives num_frames x output_dim()
+        // floats. Thread safe, usually called by one thread per stream.
+        // An error of the run, e.g. an Ort::Exception, is rethrown to every
+        // stream of the batch, the engine keeps serving the next batches.
+        void Forward(const wenet::FeatureView &feats, const float *cache,
+                     float *r_cache, float *output);
+
+        int output_dim() const { return model_->output_dim(); }
+        size_t cache_size() const { return model_->cache_size(); }
+
+    private:
+        struct Request {
+            wenet::FeatureView feats;
+            const float *cache;
+            float *r_cache;
+            float *output;
+            std::chrono::steady_clock::time_point arrival;
+            bool done;
+            // set when the run of its batch failed
+            std::exception_ptr error;
+        };
+
+        // Take the next batch from the queue, empty once stopped.
+        void NextBatch(std::vector<Request *> *batch);
+
+        void RunBatch(const std::vector<Request *> &batch);
+
+        void Loop();
+
+        std::shared_ptr<const KwsModel> model_;
+        BatchEngineConfig config_;
+        std::vector<const char *> in_names_;
+        std::vector<const char *> out_names_;
+
+        // Stacked inputs and outputs of a batch, grown to the largest one.
+        Ort::MemoryInfo memory_info_{nullptr};
+        std::unique_ptr<Ort::IoBinding> binding_;
+        wenet::AlignedVector<float> feats_;
+        wenet::AlignedVector<float> cache_;
+        wenet::AlignedVector<float> r_cache_;
+        wenet::AlignedVector<float> output_;
+
+        std::mutex mutex_;
+        // signals new requests to the worker
+        std::condition_variable queued_;
+        // signals finished batches to the streams
+        std::condition_variable done_;
+        std::deque<Request *> queue_;
+        bool stop_ = false;
+        std::thread worker_;
+    };
+
+}  // namespace wekws
+
+#endif  // KWS_BATCH_ENGINE_H_
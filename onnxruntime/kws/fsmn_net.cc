@@ -0,0 +1,594 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "kws/fsmn_net.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include "utils/cpu_features.h"
+#include "utils/mapped_file.h"
+
+#ifdef WENET_X86
+#include <immintrin.h>
+#endif
+
+namespace wekws {
+
+    namespace {
+
+        // The affine weights are packed in panels of kPanelCols output
+        // rows, stored input by input: panel p holds W[p * 16 + c][i] at
+        // (i * 16 + c), zero padded past the last output. A panel is
+        // multiplied by up to kPanelRows frames at once, each input value
+        // broadcast against 16 contiguous weights.
+        const int kPanelCols = 16;
+        const int kPanelRows = 4;
+
+        // y = relu?(x W^T + b) of rows frames and the cols valid outputs of
+        // one panel, x and y rows are ldx and ldy floats apart.
+        typedef void (*PanelFunc)(const float *x, int ldx, int in_dim,
+                                  const float *w, const float *b, bool relu,
+                                  float *y, int ldy, int cols, int rows);
+
+        void PanelScalar(const float *x, int ldx, int in_dim, const float *w,
+                         const float *b, bool relu, float *y, int ldy,
+                         int cols, int rows) {
+            for (int r = 0; r < rows; ++r) {
+                float acc[kPanelCols];
+                memcpy(acc, b, sizeof(acc));
+                const float *xr = x + r * ldx;
+                for (int i = 0; i < in_dim; ++i) {
+                    const float *wi = w + i * kPanelCols;
+                    for (int c = 0; c < kPanelCols; ++c) acc[c] += xr[i] * wi[c];
+                }
+                for (int c = 0; c < cols; ++c) {
+                    y[r * ldy + c] = relu ? std::max(acc[c], 0.0f) : acc[c];
+                }
+            }
+        }
+
+        // x[i] += a[i] * b[i], the taps of a memory block.
+        typedef void (*MulAddFunc)(const float *a, const float *b, float *y, int n);
+
+        void MulAddScalar(const float *a, const float *b, float *y, int n) {
+            for (int i = 0; i < n; ++i) y[i] += a[i] * b[i];
+        }
+
+#ifdef WENET_X86
+
+        template <int MR>
+        void PanelSse2(const float *x, int ldx, int in_dim, const float *w,
+                       const float *b, bool relu, float *y, int ldy, int cols) {
+            __m128 acc[MR][4];
+            for (int r = 0; r < MR; ++r) {
+                for (int k = 0; k < 4; ++k) acc[r][k] = _mm_load_ps(b + 4 * k);
+            }
+            for (int i = 0; i < in_dim; ++i) {
+                const float *wi = w + i * kPanelCols;
+                const __m128 w0 = _mm_load_ps(wi), w1 = _mm_load_ps(wi + 4);
+                const __m128 w2 = _mm_load_ps(wi + 8), w3 = _mm_load_ps(wi + 12);
+                for (int r = 0; r < MR; ++r) {
+                    const __m128 xv = _mm_set1_ps(x[r * ldx + i]);
+                    acc[r][0] = _mm_add_ps(acc[r][0], _mm_mul_ps(xv, w0));
+                    acc[r][1] = _mm_add_ps(acc[r][1], _mm_mul_ps(xv, w1));
+                    acc[r][2] = _mm_add_ps(acc[r][2], _mm_mul_ps(xv, w2));
+                    acc[r][3] = _mm_add_ps(acc[r][3], _mm_mul_ps(xv, w3));
+                }
+            }
+            const __m128 zero = _mm_setzero_ps();
+            for (int r = 0; r < MR; ++r) {
+                float *yr = y + r * ldy;
+                alignas(16) float tail[kPanelCols];
+                float *out = cols == kPanelCols ? yr : tail;
+                for (int k = 0; k < 4; ++k) {
+                    __m128 v = relu ? _mm_max_ps(acc[r][k], zero) : acc[r][k];
+                    _mm_storeu_ps(out + 4 * k, v);
+                }
+                if (out == tail) memcpy(yr, tail, cols * sizeof(float));
+            }
+        }
+
+        void PanelSse2Rows(const float *x, int ldx, int in_dim, const float *w,
+                           const float *b, bool relu, float *y, int ldy,
+                           int cols, int rows) {
+            switch (rows) {
+                case 4: PanelSse2<4>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+                case 3: PanelSse2<3>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+                case 2: PanelSse2<2>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+                default: PanelSse2<1>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+            }
+        }
+
+        void MulAddSse2(const float *a, const float *b, float *y, int n) {
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128 v = _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), v));
+            }
+            for (; i < n; ++i) y[i] += a[i] * b[i];
+        }
+
+#define WENET_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+        // Few frames, the streaming case, leave too few accumulators to
+        // hide the fma latency, so inputs alternate between two sets.
+        template <int MR>
+        WENET_TARGET_AVX2 void PanelAvx2(const float *x, int ldx, int in_dim,
+                                         const float *w, const float *b,
+                                         bool relu, float *y, int ldy, int cols) {
+            const int kSets = MR <= 2 ? 2 : 1;
+            __m256 acc[kSets][MR][2];
+            for (int s = 0; s < kSets; ++s) {
+                for (int r = 0; r < MR; ++r) {
+                    acc[s][r][0] = _mm256_setzero_ps();
+                    acc[s][r][1] = _mm256_setzero_ps();
+                }
+            }
+            int i = 0;
+            for (; i + kSets <= in_dim; i += kSets) {
+                for (int s = 0; s < kSets; ++s) {
+                    const float *wi = w + (i + s) * kPanelCols;
+                    const __m256 w0 = _mm256_load_ps(wi), w1 = _mm256_load_ps(wi + 8);
+                    for (int r = 0; r < MR; ++r) {
+                        const __m256 xv = _mm256_broadcast_ss(x + r * ldx + i + s);
+                        acc[s][r][0] = _mm256_fmadd_ps(xv, w0, acc[s][r][0]);
+                        acc[s][r][1] = _mm256_fmadd_ps(xv, w1, acc[s][r][1]);
+                    }
+                }
+            }
+            for (; i < in_dim; ++i) {
+                const float *wi = w + i * kPanelCols;
+                const __m256 w0 = _mm256_load_ps(wi), w1 = _mm256_load_ps(wi + 8);
+                for (int r = 0; r < MR; ++r) {
+                    const __m256 xv = _mm256_broadcast_ss(x + r * ldx + i);
+                    acc[0][r][0] = _mm256_fmadd_ps(xv, w0, acc[0][r][0]);
+                    acc[0][r][1] = _mm256_fmadd_ps(xv, w1, acc[0][r][1]);
+                }
+            }
+            const __m256 b0 = _mm256_load_ps(b), b1 = _mm256_load_ps(b + 8);
+            const __m256 zero = _mm256_setzero_ps();
+            for (int r = 0; r < MR; ++r) {
+                __m256 v0 = _mm256_add_ps(acc[0][r][0], b0);
+                __m256 v1 = _mm256_add_ps(acc[0][r][1], b1);
+                if (kSets == 2) {
+                    v0 = _mm256_add_ps(v0, acc[kSets - 1][r][0]);
+                    v1 = _mm256_add_ps(v1, acc[kSets - 1][r][1]);
+                }
+                if (relu) {
+                    v0 = _mm256_max_ps(v0, zero);
+                    v1 = _mm256_max_ps(v1, zero);
+                }
+                float *yr = y + r * ldy;
+                if (cols == kPanelCols) {
+                    _mm256_storeu_ps(yr, v0);
+                    _mm256_storeu_ps(yr + 8, v1);
+                } else {
+                    alignas(32) float tail[kPanelCols];
+                    _mm256_store_ps(tail, v0);
+                    _mm256_store_ps(tail + 8, v1);
+                    memcpy(yr, tail, cols * sizeof(float));
+                }
+            }
+        }
+
+        void PanelAvx2Rows(const float *x, int ldx, int in_dim, const float *w,
+                           const float *b, bool relu, float *y, int ldy,
+                           int cols, int rows) {
+            switch (rows) {
+                case 4: PanelAvx2<4>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+                case 3: PanelAvx2<3>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+                case 2: PanelAvx2<2>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+                default: PanelAvx2<1>(x, ldx, in_dim, w, b, relu, y, ldy, cols); break;
+            }
+        }
+
+        WENET_TARGET_AVX2 void MulAddAvx2(const float *a, const float *b,
+                                          float *y, int n) {
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                _mm256_storeu_ps(y + i, _mm256_fmadd_ps(_mm256_loadu_ps(a + i),
+                                                        _mm256_loadu_ps(b + i),
+                                                        _mm256_loadu_ps(y + i)));
+            }
+            for (; i < n; ++i) y[i] += a[i] * b[i];
+        }
+
+#endif  // WENET_X86
+
+        PanelFunc GetPanel() {
+            switch (wenet::GetSimdLevel()) {
+#ifdef WENET_X86
+                case wenet::SIMD_AVX2:
+                    return PanelAvx2Rows;
+                case wenet::SIMD_SSE2:
+                    return PanelSse2Rows;
+#endif
+                default:
+                    return PanelScalar;
+            }
+        }
+
+        MulAddFunc GetMulAdd() {
+            switch (wenet::GetSimdLevel()) {
+#ifdef WENET_X86
+                case wenet::SIMD_AVX2:
+                    return MulAddAvx2;
+                case wenet::SIMD_SSE2:
+                    return MulAddSse2;
+#endif
+                default:
+                    return MulAddScalar;
+            }
+        }
+
+        // y = relu?(x W^T + b) of rows frames, GEMV for a single frame.
+        void Gemm(const float *x, int rows, int in_dim, const float *weights,
+                  const float *bias, int out_dim, bool relu, float *y) {
+            static const PanelFunc panel = GetPanel();
+            const int num_panels = (out_dim + kPanelCols - 1) / kPanelCols;
+            for (int p = 0; p < num_panels; ++p) {
+                // one panel of weights is reused by all the frames
+                const float *w = weights + static_cast<size_t>(p) * in_dim * kPanelCols;
+                const int cols = std::min(kPanelCols, out_dim - p * kPanelCols);
+                for (int r = 0; r < rows; r += kPanelRows) {
+                    panel(x + r * in_dim, in_dim, in_dim, w, bias + p * kPanelCols,
+                          relu, y + r * out_dim + p * kPanelCols, out_dim, cols,
+                          std::min(kPanelRows, rows - r));
+                }
+            }
+        }
+
+        // Whitespace separated tokens of the nnet text. Matrices are read
+        // as a flat run of numbers, the brackets are skipped.
+        class Tokenizer {
+        public:
+            Tokenizer(const char *data, size_t size)
+                    : pos_(data), end_(data + size) {}
+
+            bool Done() {
+                SkipSpace();
+                return pos_ == end_;
+            }
+
+            std::string Next() {
+                SkipSpace();
+                const char *begin = pos_;
+                while (pos_ < end_ && !isspace(static_cast<unsigned char>(*pos_))) ++pos_;
+                return std::string(begin, pos_);
+            }
+
+            std::string Peek() {
+                const char *pos = pos_;
+                std::string token = Next();
+                pos_ = pos;
+                return token;
+            }
+
+            int ReadInt() { return ParseInt(Next()); }
+
+            void ReadFloats(size_t n, float *out) {
+                for (size_t i = 0; i < n; ++i) {
+                    // skip the brackets, on their own or stuck to a number
+                    while (true) {
+                        SkipSpace();
+                        if (pos_ < end_ && (*pos_ == '[' || *pos_ == ']')) {
+                            ++pos_;
+                        } else {
+                            break;
+                        }
+                    }
+                    if (pos_ == end_) Fail("number", "end of file");
+                    const char *begin = pos_;
+                    while (pos_ < end_ && !isspace(static_cast<unsigned char>(*pos_)) &&
+                           *pos_ != ']') {
+                        ++pos_;
+                    }
+                    std::string token(begin, pos_);
+                    char *end = nullptr;
+                    out[i] = strtof(token.c_str(), &end);
+                    if (token.empty() || *end != '\0') Fail("number", token);
+                }
+                SkipSpace();
+                if (pos_ < end_ && *pos_ == ']') ++pos_;
+            }
+
+            // <Tag> value pairs ahead of the parameters of a component.
+            std::map<std::string, std::string> ReadProperties() {
+                std::map<std::string, std::string> properties;
+                while (!Done() && Peek()[0] == '<') {
+                    std::string tag = Next();
+                    properties[tag] = Next();
+                }
+                return properties;
+            }
+
+            // token as an int, Fail() on anything else or out of range
+            static int ParseInt(const std::string &token) {
+                char *end = nullptr;
+                errno = 0;
+                long value = strtol(token.c_str(), &end, 10);
+                if (token.empty() || *end != '\0' || errno == ERANGE ||
+                    value < INT_MIN || value > INT_MAX) {
+                    Fail("integer", token);
+                }
+                return static_cast<int>(value);
+            }
+
+            [[noreturn]] static void Fail(const std::string &expected,
+                                          const std::string &token) {
+                throw std::runtime_error("Kaldi nnet: expected " + expected +
+                                         ", got \"" + token + "\"");
+            }
+
+        private:
+            void SkipSpace() {
+                while (pos_ < end_ && isspace(static_cast<unsigned char>(*pos_))) ++pos_;
+            }
+
+            const char *pos_;
+            const char *end_;
+        };
+
+        int GetInt(const std::map<std::string, std::string> &properties,
+                   const std::string &tag, int default_value) {
+            auto it = properties.find(tag);
+            return it == properties.end() ? default_value
+                                          : Tokenizer::ParseInt(it->second);
+        }
+
+    }  // namespace
+
+    FsmnNet::FsmnNet(const char *data, size_t size) {
+        Parse(data, size);
+        Optimize();
+    }
+
+    FsmnNet::FsmnNet(const std::string &path) {
+        wenet::MappedFile file;
+        if (!file.Open(path)) {
+            throw std::runtime_error("Failed to map kaldi nnet: " + path);
+        }
+        Parse(file.data(), file.size());
+        Optimize();
+    }
+
+    bool FsmnNet::IsKaldiNet(const char *data, size_t size) {
+        size_t i = 0;
+        while (i < size && isspace(static_cast<unsigned char>(data[i]))) ++i;
+        return size - i >= 6 && memcmp(data + i, "<Nnet>", 6) == 0;
+    }
+
+    void FsmnNet::Parse(const char *data, size_t size) {
+        Tokenizer tokenizer(data, size);
+        std::string token = tokenizer.Next();
+        if (token != "<Nnet>") Tokenizer::Fail("<Nnet>", token);
+        while (true) {
+            if (tokenizer.Done()) Tokenizer::Fail("</Nnet>", "end of file");
+            const std::string component = tokenizer.Next();
+            if (component == "</Nnet>") break;
+            if (component == "<!EndOfComponent>") continue;
+            Layer layer;
+            layer.output_dim = tokenizer.ReadInt();
+            layer.input_dim = tokenizer.ReadInt();
+            if (layer.output_dim <= 0 || layer.input_dim <= 0) {
+                throw std::runtime_error("Kaldi nnet: bad dims of " + component);
+            }
+            const int dim = layer.output_dim;
+            if (component == "<AffineTransform>" || component == "<LinearTransform>") {
+                // W is read as is here, packed by Optimize()
+                layer.type = kAffine;
+                tokenizer.ReadProperties();
+                layer.weights.resize(static_cast<size_t>(dim) * layer.input_dim);
+                tokenizer.ReadFloats(layer.weights.size(), layer.weights.data());
+                layer.bias.assign(dim, 0.0f);
+                if (component == "<AffineTransform>") {
+                    tokenizer.ReadFloats(dim, layer.bias.data());
+                }
+            } else if (component == "<Fsmn>") {
+                layer.type = kFsmn;
+                auto properties = tokenizer.ReadProperties();
+                layer.lorder = GetInt(properties, "<LOrder>", 1);
+                layer.rorder = GetInt(properties, "<ROrder>", 0);
+                layer.lstride = GetInt(properties, "<LStride>", 1);
+                layer.rstride = GetInt(properties, "<RStride>", 1);
+                if (layer.lorder < 1 || layer.rorder < 0 || layer.lstride < 1 ||
+                    layer.rstride < 1) {
+                    throw std::runtime_error("Kaldi nnet: bad orders of <Fsmn>");
+                }
+                layer.left_filters.resize(static_cast<size_t>(layer.lorder) * dim);
+                tokenizer.ReadFloats(layer.left_filters.size(), layer.left_filters.data());
+                layer.right_filters.resize(static_cast<size_t>(layer.rorder) * dim);
+                tokenizer.ReadFloats(layer.right_filters.size(), layer.right_filters.data());
+                layer.cache_len = (layer.lorder - 1) * layer.lstride +
+                                  layer.rorder * layer.rstride;
+            } else if (component == "<AddShift>" || component == "<Rescale>") {
+                layer.type = kScaleShift;
+                tokenizer.ReadProperties();
+                layer.scale.assign(dim, 1.0f);
+                layer.shift.assign(dim, 0.0f);
+                std::vector<float> &values = component == "<AddShift>" ?
+                                             layer.shift : layer.scale;
+                tokenizer.ReadFloats(dim, values.data());
+            } else if (component == "<RectifiedLinear>") {
+                layer.type = kRelu;
+            } else if (component == "<Softmax>") {
+                layer.type = kSoftmax;
+            } else {
+                throw std::runtime_error("Kaldi nnet: unsupported component " + component);
+            }
+            if (layer.type != kAffine && layer.input_dim != dim) {
+                throw std::runtime_error("Kaldi nnet: " + component +
+                                         " changes the dim");
+            }
+            if (!layers_.empty() && layers_.back().output_dim != layer.input_dim) {
+                throw std::runtime_error("Kaldi nnet: the input dim of " + component +
+                                         " does not match the previous output");
+            }
+            layers_.push_back(std::move(layer));
+        }
+        if (layers_.empty()) throw std::runtime_error("Kaldi nnet: no component");
+    }
+
+    void FsmnNet::Optimize() {
+        std::vector<Layer> layers;
+        for (Layer &layer : layers_) {
+            if (!layers.empty()) {
+                Layer &prev = layers.back();
+                if (prev.type == kScaleShift && layer.type == kScaleShift) {
+                    // (x * s1 + a1) * s2 + a2
+                    for (int d = 0; d < layer.output_dim; ++d) {
+                        prev.scale[d] *= layer.scale[d];
+                        prev.shift[d] = prev.shift[d] * layer.scale[d] + layer.shift[d];
+                    }
+                    continue;
+                }
+                if (prev.type == kScaleShift && layer.type == kAffine) {
+                    // W (x * s + a) + b = (W diag(s)) x + (W a + b)
+                    for (int o = 0; o < layer.output_dim; ++o) {
+                        float *w = layer.weights.data() +
+                                   static_cast<size_t>(o) * layer.input_dim;
+                        double bias = layer.bias[o];
+                        for (int i = 0; i < layer.input_dim; ++i) {
+                            bias += static_cast<double>(w[i]) * prev.shift[i];
+                            w[i] *= prev.scale[i];
+                        }
+                        layer.bias[o] = static_cast<float>(bias);
+                    }
+                    prev = std::move(layer);
+                    continue;
+                }
+                if (prev.type == kAffine && !prev.relu && layer.type == kRelu) {
+                    prev.relu = true;
+                    continue;
+                }
+            }
+            layers.push_back(std::move(layer));
+        }
+        layers_ = std::move(layers);
+
+        input_dim_ = layers_.front().input_dim;
+        output_dim_ = layers_.back().output_dim;
+        for (Layer &layer : layers_) {
+            max_dim_ = std::max(max_dim_, layer.output_dim);
+            if (layer.type == kAffine) {
+                // pack W into panels, see Gemm()
+                const int num_panels = (layer.output_dim + kPanelCols - 1) / kPanelCols;
+                wenet::AlignedVector<float> packed(
+                        static_cast<size_t>(num_panels) * layer.input_dim * kPanelCols, 0.0f);
+                for (int o = 0; o < layer.output_dim; ++o) {
+                    const int p = o / kPanelCols, c = o % kPanelCols;
+                    for (int i = 0; i < layer.input_dim; ++i) {
+                        packed[(static_cast<size_t>(p) * layer.input_dim + i) * kPanelCols + c] =
+                                layer.weights[static_cast<size_t>(o) * layer.input_dim + i];
+                    }
+                }
+                layer.weights.swap(packed);
+                layer.bias.resize(num_panels * kPanelCols, 0.0f);
+            } else if (layer.type == kFsmn) {
+                layer.cache_offset = cache_size_;
+                cache_size_ += static_cast<size_t>(layer.cache_len) * layer.output_dim;
+                if (num_fsmn_layers_++ == 0) cache_len_ = layer.cache_len;
+            }
+        }
+    }
+
+    void FsmnNet::Forward(const float *feats, int num_frames, const float *cache,
+                          float *r_cache, float *output, Workspace *workspace) const {
+        static const MulAddFunc mul_add = GetMulAdd();
+        const size_t max_size = static_cast<size_t>(num_frames) * max_dim_;
+        for (int k = 0; k < 2; ++k) {
+            if (workspace->buffers[k].size() < max_size) workspace->buffers[k].resize(max_size);
+        }
+        const float *in = feats;
+        for (size_t l = 0; l < layers_.size(); ++l) {
+            const Layer &layer = layers_[l];
+            const int dim = layer.output_dim;
+            float *out = l + 1 == layers_.size() ? output : workspace->buffers[l % 2].data();
+            switch (layer.type) {
+                case kAffine:
+                    Gemm(in, num_frames, layer.input_dim, layer.weights.data(),
+                         layer.bias.data(), dim, layer.relu, out);
+                    break;
+                case kFsmn: {
+                    // The memory block, the cached frames followed by the
+                    // new ones. The output frame t is centered on the block
+                    // frame lorder_frames + t.
+                    const int cache_len = layer.cache_len;
+                    const size_t block_size = static_cast<size_t>(cache_len + num_frames) * dim;
+                    wenet::AlignedVector<float> &block = workspace->memory;
+                    if (block.size() < block_size) block.resize(block_size);
+                    const size_t cached = static_cast<size_t>(cache_len) * dim;
+                    memcpy(block.data(), cache + layer.cache_offset, cached * sizeof(float));
+                    memcpy(block.data() + cached, in, static_cast<size_t>(num_frames) * dim * sizeof(float));
+                    // the last cache_len frames are the next cache
+                    memcpy(r_cache + layer.cache_offset,
+                           block.data() + static_cast<size_t>(num_frames) * dim,
+                           cached * sizeof(float));
+                    const int lorder_frames = (layer.lorder - 1) * layer.lstride;
+                    for (int t = 0; t < num_frames; ++t) {
+                        const float *center = block.data() +
+                                              static_cast<size_t>(lorder_frames + t) * dim;
+                        float *y = out + static_cast<size_t>(t) * dim;
+                        memcpy(y, center, dim * sizeof(float));
+                        for (int i = 0; i < layer.lorder; ++i) {
+                            mul_add(layer.left_filters.data() + i * dim,
+                                    center - static_cast<ptrdiff_t>(i) * layer.lstride * dim, y, dim);
+                        }
+                        for (int j = 0; j < layer.rorder; ++j) {
+                            mul_add(layer.right_filters.data() + j * dim,
+                                    center + static_cast<ptrdiff_t>(j + 1) * layer.rstride * dim, y, dim);
+                        }
+                    }
+                    break;
+                }
+                case kScaleShift:
+                    for (int t = 0; t < num_frames; ++t) {
+                        for (int d = 0; d < dim; ++d) {
+                            out[t * dim + d] = in[t * dim + d] * layer.scale[d] + layer.shift[d];
+                        }
+                    }
+                    break;
+                case kRelu:
+                    for (int i = 0; i < num_frames * dim; ++i) out[i] = std::max(in[i], 0.0f);
+                    break;
+                case kSoftmax:
+                    for (int t = 0; t < num_frames; ++t) {
+                        const float *x = in + t * dim;
+                        float *y = out + t * dim;
+                        const float max = *std::max_element(x, x + dim);
+                        float sum = 0.0f;
+                        for (int d = 0; d < dim; ++d) {
+                            y[d] = std::exp(x[d] - max);
+                            sum += y[d];
+                        }
+                        for (int d = 0; d < dim; ++d) y[d] /= sum;
+                    }
+                    break;
+            }
+            in = out;
+        }
+    }
+
+}  // namespace wekws
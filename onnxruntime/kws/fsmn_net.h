@@ -0,0 +1,120 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KWS_FSMN_NET_H_
+#define KWS_FSMN_NET_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "utils/aligned_allocator.h"
+
+namespace wekws {
+
+    // A streaming FSMN run natively, without onnxruntime, from the Kaldi
+    // nnet1 text written by FSMN.to_kaldi_net() of model_convert, see
+    // model_convert/export_kaldi_net.py. The components are
+    //   <AffineTransform> <LinearTransform> <Fsmn> <RectifiedLinear>
+    //   <Softmax>, and <AddShift> <Rescale> of a global cmvn.
+    // The cmvn is folded into the next affine transform and a relu into
+    // the previous one when the net is loaded.
+    //
+    // The net is immutable once loaded and shared by the streams. Each
+    // stream keeps its memory blocks in a cache of cache_size() floats,
+    // the last cache_len frames of the input of every <Fsmn>, and its
+    // scratch buffers in a Workspace.
+    class FsmnNet {
+    public:
+        // Per stream scratch buffers of Forward(), grown on demand.
+        struct Workspace {
+            wenet::AlignedVector<float> buffers[2];
+            wenet::AlignedVector<float> memory;
+        };
+
+        // Parse the net from size bytes of text. Throw std::runtime_error
+        // on a malformed or unsupported net.
+        FsmnNet(const char *data, size_t size);
+
+        explicit FsmnNet(const std::string &path);
+
+        // Whether data starts as a Kaldi nnet, with <Nnet>.
+        static bool IsKaldiNet(const char *data, size_t size);
+
+        // Forward num_frames rows of feats, input_dim() floats each. cache
+        // is read and the new cache written to r_cache, both of
+        // cache_size() floats, a zero cache starts a stream. output
+        // receives num_frames x output_dim() floats. Every <Fsmn> of right
+        // order rorder delays the output by rorder * rstride frames, as
+        // the onnx model does.
+        void Forward(const float *feats, int num_frames, const float *cache,
+                     float *r_cache, float *output, Workspace *workspace) const;
+
+        int input_dim() const { return input_dim_; }
+        int output_dim() const { return output_dim_; }
+        size_t cache_size() const { return cache_size_; }
+        int num_fsmn_layers() const { return num_fsmn_layers_; }
+        // frames of the cache of the first <Fsmn>, as the onnx cache_len
+        int cache_len() const { return cache_len_; }
+
+    private:
+        enum LayerType {
+            kAffine,      // y = W x + b, then an optional relu
+            kFsmn,        // memory block
+            kScaleShift,  // y = x * scale + shift, a cmvn left unfolded
+            kRelu,
+            kSoftmax,
+        };
+
+        struct Layer {
+            LayerType type;
+            int input_dim = 0;
+            int output_dim = 0;
+            // kAffine, W packed in panels of kPanelCols rows, see
+            // PackWeights(), and b padded to the panels.
+            wenet::AlignedVector<float> weights;
+            wenet::AlignedVector<float> bias;
+            bool relu = false;
+            // kFsmn, left filter i weights the frame i * lstride before
+            // the current one, right filter j the frame (j + 1) * rstride
+            // after it, output_dim floats each.
+            int lorder = 0, rorder = 0, lstride = 1, rstride = 1;
+            wenet::AlignedVector<float> left_filters;
+            wenet::AlignedVector<float> right_filters;
+            int cache_len = 0;
+            size_t cache_offset = 0;
+            // kScaleShift
+            std::vector<float> scale;
+            std::vector<float> shift;
+        };
+
+        void Parse(const char *data, size_t size);
+
+        // Fold the cmvn into the following affine transform and the relus
+        // into the preceding one, then pack the weights.
+        void Optimize();
+
+        std::vector<Layer> layers_;
+        int input_dim_ = 0;
+        int output_dim_ = 0;
+        int max_dim_ = 0;
+        size_t cache_size_ = 0;
+        int num_fsmn_layers_ = 0;
+        int cache_len_ = 0;
+    };
+
+}  // namespace wekws
+
+#endif  // KWS_FSMN_NET_H_
@@ -25,10 +25,9 @@
 #include <cmath>
 #include <algorithm>
 
-namespace wekws {
+#include "utils/log.h"
 
-    Ort::Env KeywordSpotting::env_ = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "");
-    Ort::SessionOptions KeywordSpotting::session_options_ = Ort::SessionOptions();
+namespace wekws {
 
     static void print_vector(const std::vector<int> &arr) {
         if (!arr.empty()) {
@@ -46,51 +45,43 @@ namespace wekws {
         return a.second.total_score() > b.second.total_score();
     }
 
-    KeywordSpotting::KeywordSpotting(const std::string &model_path, DECODE_TYPE decode_type, int model_type) {
-        // 0. set decode type from {DECODE_GREEDY_SEARCH, DECODE_PREFIX_BEAM_SEARCH}
+    KwsStream::KwsStream(std::shared_ptr<const KwsModel> model,
+                         DECODE_TYPE decode_type)
+            : model_(std::move(model)) {
+        // set decode type from {DECODE_GREEDY_SEARCH, DECODE_PREFIX_BEAM_SEARCH}
         mdecode_type = decode_type;
-        mmodel_type = model_type;
-
-        // 1. Load onnx runtime sessions
-        session_ = std::make_shared<Ort::Session>(env_, model_path.c_str(),
-                                                  session_options_);
-        // 2. Model info. Information can be view from netron.
-        // pip install netron. netron [model_path]
         in_names_ = {"input", "cache"};
         out_names_ = {"output", "r_cache"};
-        auto metadata = session_->GetModelMetadata();
-        Ort::AllocatorWithDefaultOptions allocator;
-        cache_dim_ = std::stoi(metadata.LookupCustomMetadataMap("cache_dim",
-                                                                allocator));
-        cache_len_ = std::stoi(metadata.LookupCustomMetadataMap("cache_len",
-                                                                allocator));
-        std::cout << "Kws Model Info:" << std::endl
-                  << "\tcache_dim: " << cache_dim_ << std::endl
-                  << "\tcache_len: " << cache_len_ << std::endl;
-
-        Reset();
 
+        // Buffers bound once to the model inputs and outputs. The cache is
+        // read from one of the two buffers and written to the other one.
+        for (int i = 0; i < 2; i++) cache_[i].assign(model_->cache_size(), 0.0f);
+#ifdef USE_ONNX
+        if (model_->session() != nullptr) {
+            memory_info_ = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+            binding_.reset(new Ort::IoBinding(*model_->session()));
+            const std::vector<int64_t> &cache_shape = model_->cache_shape();
+            for (int i = 0; i < 2; i++) {
+                cache_ort_[i] = Ort::Value::CreateTensor<float>(
+                        memory_info_, cache_[i].data(), cache_[i].size(),
+                        cache_shape.data(), cache_shape.size());
+            }
+        }
+#endif
 
+        Reset();
     }
 
-    void KeywordSpotting::Reset() {
-        Ort::MemoryInfo memory_info =
-                Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-        if(mmodel_type == 1){ // ctc model
-            cache_.resize(cache_dim_ * cache_len_ * cache_4_, 0.0);
-            const int64_t cache_shape[] = {1, cache_dim_, cache_len_, cache_4_};
-            cache_ort_ = Ort::Value::CreateTensor<float>(
-                    memory_info, cache_.data(), cache_.size(), cache_shape, 4);
+    void KwsStream::Reset() {
+        // The model starts from a zero cache.
+        cur_cache_ = 0;
+        std::fill(cache_[0].begin(), cache_[0].end(), 0.0f);
+        if(model_->model_type() == 1){ // ctc model
             reset_value();
-        }else{ // max pooling model
-            cache_.resize(cache_dim_ * cache_len_ , 0.0);
-            const int64_t cache_shape[] = {1, cache_dim_, cache_len_};
-            cache_ort_ = Ort::Value::CreateTensor<float>(
-                    memory_info, cache_.data(), cache_.size(), cache_shape, 3);
         }
     }
 
-    void KeywordSpotting::reset_value() {
+    void KwsStream::reset_value() {
         if (mdecode_type == DECODE_PREFIX_BEAM_SEARCH) {
             cur_hyps_.clear();
             PrefixScore prefix_score;
@@ -106,96 +97,76 @@ namespace wekws {
         }
     }
 
-    void KeywordSpotting::Forward(
-            const std::vector<std::vector<float>> &feats,
-            std::vector<std::vector<float>> *prob) {
-        prob->clear();
-        if (feats.size() == 0) return;
-        Ort::MemoryInfo memory_info =
-                Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-        // 1. Prepare input
-        int num_frames = feats.size();
-        int feature_dim = feats[0].size();
-        std::vector<float> slice_feats;
-        for (int i = 0; i < feats.size(); i++) {
-            slice_feats.insert(slice_feats.end(), feats[i].begin(), feats[i].end());
+    void KwsStream::Forward(const wenet::FeatureView &feats,
+                            wenet::FeatureView *prob) {
+        *prob = wenet::FeatureView();
+        if (feats.empty()) return;
+        skipping_ = false;
+        const int num_frames = feats.num_rows();
+        const int output_dim = model_->output_dim();
+        if (output_.size() < static_cast<size_t>(num_frames) * output_dim) {
+            output_.resize(num_frames * output_dim);
+#ifdef USE_ONNX
+            output_frames_ = 0;  // the output tensor views the old buffer
+#endif
         }
-        const int64_t feats_shape[3] = {1, num_frames, feature_dim};
-        Ort::Value feats_ort = Ort::Value::CreateTensor<float>(
-                memory_info, slice_feats.data(), slice_feats.size(), feats_shape, 3);
-        // 2. Ort forward
-        std::vector<Ort::Value> inputs;
-        inputs.emplace_back(std::move(feats_ort));
-        inputs.emplace_back(std::move(cache_ort_));
-        // ort_outputs.size() == 2
-        std::vector<Ort::Value> ort_outputs = session_->Run(
-                Ort::RunOptions{nullptr}, in_names_.data(), inputs.data(),
-                inputs.size(), out_names_.data(), out_names_.size());
-
-        // 3. Update cache
-        cache_ort_ = std::move(ort_outputs[1]);
-
-        // 4. Get keyword prob
-        float *data = ort_outputs[0].GetTensorMutableData<float>();
-        auto type_info = ort_outputs[0].GetTensorTypeAndShapeInfo();
-        int num_outputs = type_info.GetShape()[1];
-        int output_dim = type_info.GetShape()[2];
-        prob->resize(num_outputs);
-        for (int i = 0; i < num_outputs; i++) {
-            (*prob)[i].resize(output_dim);
-            memcpy((*prob)[i].data(), data + i * output_dim,
-                   sizeof(float) * output_dim);
+#ifdef USE_ONNX
+        if (batch_engine_ != nullptr) {
+            batch_engine_->Forward(feats, cache_[cur_cache_].data(),
+                                   cache_[1 - cur_cache_].data(), output_.data());
+            cur_cache_ = 1 - cur_cache_;
+            *prob = wenet::FeatureView(output_.data(), num_frames, output_dim);
+            return;
         }
-    }
-
-    void KeywordSpotting::readToken(const std::string &tokenFile) {
-        std::ifstream fin(tokenFile);
-
-        if (fin.is_open()) {
-            std::string line;
-            while (std::getline(fin, line)) {
-                if(mmodel_type==1){
-                    std::string token;
-                    int value;
-                    std::istringstream iss(line);
-                    if (iss >> token >> value) {
-                        mvocab[token] = value - 1;
-                    }
-                }else{
-                    mmaxpooling_keywords.push_back(line);
-                }
-            }
-            fin.close();
-        } else {
-            std::cerr << "Error: Unable to open the token file." << std::endl;
+#endif
+        if (model_->fsmn_net() != nullptr) {
+            // Native net, straight from the feature rows to the output.
+            const FsmnNet *net = model_->fsmn_net();
+            CHECK(feats.num_cols() == net->input_dim());
+            net->Forward(feats.data(), num_frames, cache_[cur_cache_].data(),
+                         cache_[1 - cur_cache_].data(), output_.data(),
+                         &fsmn_workspace_);
+            cur_cache_ = 1 - cur_cache_;
+            *prob = wenet::FeatureView(output_.data(), num_frames, output_dim);
+            return;
         }
-
-    }
-
-    void KeywordSpotting::setKeyWord(const std::string &keyWord) {
-        /*keyWord : key word to wakeup.
-         * */
-        mkey_word = keyWord;
-        mkeyword_set.insert(0);  // insert 0 for blank token of ctc.
-        for (int idx = 0; idx < keyWord.size(); idx += 3) { // 3byte for chinese char with utf8.
-            std::string token = keyWord.substr(idx, 3);
-            int toekn_idx = mvocab.at(token);
-            if (mvocab.count(token) > 0) {
-                if (mkeyword_set.count(toekn_idx) == 0) {
-                    mkeyword_set.insert(toekn_idx);
-                }
-                mkeyword_token.push_back(toekn_idx);
-            } else {
-                std::cerr << "Can not find" << " " << keyWord << " " << "in vocab. Please check.";
-            }
+#ifdef USE_ONNX
+        // 1. Input, the contiguous feature rows are the tensor buffer.
+        // onnxruntime does not write to its inputs.
+        const int64_t feats_shape[3] = {1, num_frames, feats.num_cols()};
+        Ort::Value feats_ort = Ort::Value::CreateTensor<float>(
+                memory_info_, const_cast<float *>(feats.data()), feats.size(),
+                feats_shape, 3);
+        binding_->BindInput(in_names_[0], feats_ort);
+        // 2. Ping-pong cache, the model reads one buffer and writes the other.
+        binding_->BindInput(in_names_[1], cache_ort_[cur_cache_]);
+        binding_->BindOutput(out_names_[1], cache_ort_[1 - cur_cache_]);
+        // 3. Output, written into a buffer kept across calls. Its tensor is
+        // only recreated when the number of frames changes.
+        if (num_frames != output_frames_) {
+            const int64_t output_shape[3] = {1, num_frames, output_dim};
+            output_ort_ = Ort::Value::CreateTensor<float>(
+                    memory_info_, output_.data(), num_frames * output_dim,
+                    output_shape, 3);
+            output_frames_ = num_frames;
         }
+        binding_->BindOutput(out_names_[0], output_ort_);
+        // 4. Ort forward
+        model_->session()->Run(Ort::RunOptions{nullptr}, *binding_);
+        cur_cache_ = 1 - cur_cache_;
+        *prob = wenet::FeatureView(output_.data(), num_frames, output_dim);
+#endif
     }
 
-    bool KeywordSpotting::isKeyword(int index) {
-        return mkeyword_set.count(index) > 0;
+    void KwsStream::SkipNonSpeech(int num_frames) {
+        if (!skipping_) {
+            Reset();
+            skipping_ = true;
+        }
+        mGTimeStep += num_frames;
     }
 
-    void KeywordSpotting::UpdateHypotheses(const std::vector<std::pair<std::vector<int>, PrefixScore>> &hpys) {
+    void KwsStream::UpdateHypotheses(const std::vector<std::pair<std::vector<int>, PrefixScore>> &hpys) {
         cur_hyps_.clear();
         for (auto &item: hpys) {
             // std::vector<int> prefix =  item.first;
@@ -207,7 +178,7 @@ namespace wekws {
                 cur_hyps_[empty] = prefix_score;
             } else {
                 // filter illegal prefix case.
-                if(item.first.size() > mkeyword_token.size()) {
+                if(item.first.size() > model_->keyword_token().size()) {
                     continue;
                 }
                 cur_hyps_[item.first] = item.second;
@@ -220,7 +191,7 @@ namespace wekws {
 
     }
 
-    void KeywordSpotting::decode_keywords(std::vector<std::vector<float>> &probs, float hitScoreThr) {
+    void KwsStream::decode_keywords(const wenet::FeatureView &probs, float hitScoreThr) {
         /*decode keyword.
          */
         if (mdecode_type == DECODE_GREEDY_SEARCH) {
@@ -230,9 +201,9 @@ namespace wekws {
 
         } else if (mdecode_type == DECODE_PREFIX_BEAM_SEARCH) {
             // std::cout << "DECODE_PREFIX_BEAM_SEARCH" << std::endl;
-            for (const auto &prob: probs) {
+            for (int t = 0; t < probs.num_rows(); t++) {
 
-                decode_ctc_prefix_beam_search(mGTimeStep, prob);
+                decode_ctc_prefix_beam_search(mGTimeStep, probs.Row(t), probs.num_cols());
                 mGTimeStep += 1;
                 execute_detection(hitScoreThr);
                 if (activated) {
@@ -245,15 +216,16 @@ namespace wekws {
         }
     }
 
-    void KeywordSpotting::decode_with_greedy_search(int offset, std::vector<std::vector<float>> &probs) {
+    void KwsStream::decode_with_greedy_search(int offset, const wenet::FeatureView &probs) {
 
         // find index with max-prob in each time step.
-        for (int i = 0; i < probs.size(); i++) {
+        for (int i = 0; i < probs.num_rows(); i++) {
+            const float *prob = probs.Row(i);
             std::cout << "frame " << std::setw(3) << offset + i;
-            auto maxElement = std::max_element(probs[i].begin(), probs[i].end());
-            int maxIndex = std::distance(probs[i].begin(), maxElement);
-            std::cout << " maxIndex " << std::setw(4) << maxIndex << " prob " << probs[i][maxIndex];
-            Token token = {offset + i, maxIndex, probs[i][maxIndex]};
+            const float *maxElement = std::max_element(prob, prob + probs.num_cols());
+            int maxIndex = maxElement - prob;
+            std::cout << " maxIndex " << std::setw(4) << maxIndex << " prob " << prob[maxIndex];
+            Token token = {offset + i, maxIndex, prob[maxIndex]};
             alignments.emplace_back(token);
             std::cout << std::endl;
         }
@@ -262,7 +234,7 @@ namespace wekws {
         // it's not update prob when meeting same token, now.
         std::unordered_set<int> seenIds;
         for (const auto &token: alignments) {
-            if (token.id != 0 && isKeyword(token.id)) {
+            if (token.id != 0 && model_->isKeyword(token.id)) {
                 if (seenIds.count(token.id) == 0) {
                     // not see token in current hyp.
                     gd_cur_hyps.push_back(token);
@@ -275,7 +247,7 @@ namespace wekws {
         alignments.clear();
     }
 
-    void KeywordSpotting::decode_ctc_prefix_beam_search(int stepT, const std::vector<float> &probv) {
+    void KwsStream::decode_ctc_prefix_beam_search(int stepT, const float *probv, int num_tokens) {
         /* Decoding ctc sequence with prefix beam search.
          * ref: https://distill.pub/2017/ctc/
          * python implement
@@ -284,13 +256,13 @@ namespace wekws {
          * */
 
 //        std::cout << "stepT=" << std::setw(3) << stepT << std::endl;
-        if (probv.size() == 0) return;
+        if (num_tokens == 0) return;
         std::unordered_map<std::vector<int>, PrefixScore, PrefixHash> next_hyps;
 
         // 1. First beam prune, only select topk candidates
         std::vector<float> topk_probs;
         std::vector<int> topk_index;
-        TopK(probv, opts_.first_beam_size, &topk_probs, &topk_index);
+        TopK(probv, num_tokens, opts_.first_beam_size, &topk_probs, &topk_index);
 
         // filter prob score that is too small.
         std::vector<float> filter_probs;
@@ -299,8 +271,8 @@ namespace wekws {
             int idx = topk_index[i];
             float prob = probv[idx];
 
-            if (!mkeyword_set.empty()) {
-                if (prob > 0.05 && isKeyword(idx)) {
+            if (model_->has_keyword()) {
+                if (prob > 0.05 && model_->isKeyword(idx)) {
                     filter_probs.push_back(prob);
                     filter_index.push_back(idx);
                 }
@@ -399,7 +371,7 @@ namespace wekws {
 
     }
 
-     void KeywordSpotting::execute_detection(float hitScoreThr) {
+     void KwsStream::execute_detection(float hitScoreThr) {
         /*　对当前输出的prfix串和关键词进行对比，判断是否唤醒.
          * */
 
@@ -407,22 +379,22 @@ namespace wekws {
             for (const auto &it: cur_hyps_) {
                 const std::vector<int> &prefix = it.first;
                 const std::vector<Token> &nodes = it.second.nodes;
-                if (!prefix.empty() && prefix.size() == mkeyword_token.size()) {
+                if (!prefix.empty() && prefix.size() == model_->keyword_token().size()) {
                     int num = 0;
                     for (auto i = 0; i < prefix.size(); i++) {
-                        num += (prefix[i] != mkeyword_token[i]) ? 0 : 1;
+                        num += (prefix[i] != model_->keyword_token()[i]) ? 0 : 1;
                         kwsInfo.hit_score *= nodes[i].prob;
                         if (i == 0) kwsInfo.start_frame = nodes[i].timeStep;
                         if (i == nodes.size() - 1) kwsInfo.end_frame= nodes[i].timeStep;
                     }
-                    activated = (num==mkeyword_token.size()) ? true : false;
+                    activated = (num==model_->keyword_token().size()) ? true : false;
                 }
                 kwsInfo.hit_score = std::sqrt(kwsInfo.hit_score);
                 activated = (kwsInfo.hit_score > hitScoreThr) ? activated : false;
                 kwsInfo.state = activated;
                 if (activated == true) {
 
-                    std::cout  << "keyword=" << mkey_word
+                    std::cout  << "keyword=" << model_->keyword()
                                << " hitscore=" << kwsInfo.hit_score << " hitScoreThr=" << hitScoreThr
                                << " start T=" << kwsInfo.start_frame
                                << " end T=" << kwsInfo.end_frame << std::endl;
@@ -432,21 +404,21 @@ namespace wekws {
             }
         } else {
             //  std::cout << "cur_hyps size: " << cur_hyps.size() << " kws size: " << this->mkws_ids.size() <<std::endl;
-            if (!gd_cur_hyps.empty() && mkeyword_token.size() == gd_cur_hyps.size()) {
+            if (!gd_cur_hyps.empty() && model_->keyword_token().size() == gd_cur_hyps.size()) {
                 int num = 0;
                 for (auto i = 0; i < gd_cur_hyps.size(); i++) {
-                    num += (gd_cur_hyps[i].id != mkeyword_token[i]) ? 0 : 1;
+                    num += (gd_cur_hyps[i].id != model_->keyword_token()[i]) ? 0 : 1;
                     kwsInfo.hit_score *= gd_cur_hyps[i].prob;
                     if (i == 0) kwsInfo.start_frame = gd_cur_hyps[i].timeStep;
                     if (i == gd_cur_hyps.size() - 1) kwsInfo.end_frame = gd_cur_hyps[i].timeStep;
                 }
-                activated = (num==mkeyword_token.size()) ? true : false;
+                activated = (num==model_->keyword_token().size()) ? true : false;
             }
         }
 
     }
 
-    void KeywordSpotting::stepClear(){
+    void KwsStream::stepClear(){
         mGTimeStep = 0;
     }
 
@@ -22,9 +22,15 @@
 #include <vector>
 #include <iomanip>
 #include <unordered_set>
+#include <utility>
 
-#include "onnxruntime_cxx_api.h"  // NOLINT
+#include "frontend/feature_matrix.h"
+#include "kws/kws_model.h"
 #include "kws/utils.h"
+#ifdef USE_ONNX
+#include "onnxruntime_cxx_api.h"  // NOLINT
+#include "kws/batch_engine.h"
+#endif
 
 namespace wekws {
 
@@ -71,48 +77,55 @@ namespace wekws {
         DECODE_PREFIX_BEAM_SEARCH=1,
     }DECODE_TYPE;
 
-    class KeywordSpotting {
+    // The state of one stream spotted with a shared KwsModel: its model
+    // cache, inference buffers and decoder. Streams are cheap, one per
+    // audio stream or channel, all of them running the same session.
+    class KwsStream {
     public:
-        explicit KeywordSpotting(const std::string &model_path, DECODE_TYPE decode_type, int model_type);
+        KwsStream(std::shared_ptr<const KwsModel> model, DECODE_TYPE decode_type);
+
+        const KwsModel &model() const { return *model_; }
 
         void Reset();
 
         void reset_value();
 
-        static void InitEngineThreads(int num_threads) {
-            session_options_.SetIntraOpNumThreads(num_threads);
-            session_options_.SetInterOpNumThreads(num_threads);
-        }
+        // feats is used in place as the input tensor, a FeatureMatrix
+        // converts to it. prob views the num_frames x output_dim() output
+        // rows, in a buffer of the stream valid until the next Forward().
+        void Forward(const wenet::FeatureView &feats, wenet::FeatureView *prob);
 
-        void Forward(const std::vector<std::vector<float>> &feats,
-                     std::vector<std::vector<float>> *prob);
+#ifdef USE_ONNX
+        // Forward() through engine, batched with the chunks of the other
+        // streams of the same model, instead of a run of its own.
+        void set_batch_engine(std::shared_ptr<BatchEngine> engine) {
+            batch_engine_ = std::move(engine);
+        }
+#endif
 
-        // function to load vocab from token.txt
-        void readToken(const std::string& tokenFile) ;
+        // vocab size of the ctc models, number of keywords otherwise
+        int output_dim() const { return model_->output_dim(); }
 
-        // set keyword
-        void setKeyWord(const std::string& keyWord);
+        // Skip num_frames non-speech input frames instead of Forward() and
+        // decoding them. The first skip of a silence span resets the model
+        // cache and the decoder, as at the stream start, the time steps
+        // still move on.
+        void SkipNonSpeech(int num_frames);
 
-        void decode_keywords(std::vector<std::vector<float>>& probs, float hitScoreThr=0.0);
+        void decode_keywords(const wenet::FeatureView& probs, float hitScoreThr=0.0);
 
         // decoding alignments to predict sequence using greedy search.
-        void decode_with_greedy_search(int offset,  std::vector<std::vector<float>>& probs);
+        void decode_with_greedy_search(int offset, const wenet::FeatureView& probs);
 
         // decoding alignments to predict sequence using prefix beam search.
-        void decode_ctc_prefix_beam_search(int offset, const std::vector<float> &prob);
+        void decode_ctc_prefix_beam_search(int offset, const float *prob, int num_tokens);
 
         // find keyword
         void execute_detection(float hitScoreThr=0.1);
 
-        // Token is keyword or not.
-        bool isKeyword(int index);
-
         //update current hypotheses from proposed extensions.
         void UpdateHypotheses(const std::vector<std::pair<std::vector<int>, PrefixScore>>& hpys);
 
-        // maxpooling keywords
-        std::vector<std::string> mmaxpooling_keywords;
-
         //time stemp reset
         void stepClear();
 
@@ -121,39 +134,32 @@ namespace wekws {
 
 
     private:
-        // onnx runtime session
-        static Ort::Env env_;
-        static Ort::SessionOptions session_options_;
-        std::shared_ptr<Ort::Session> session_ = nullptr;
+        std::shared_ptr<const KwsModel> model_;
 
         // model node names
         std::vector<const char *> in_names_;
         std::vector<const char *> out_names_;
 
-        // meta info
-        int cache_dim_ = 0;
-        int cache_len_ = 0;
-        int cache_4_ = 4;
-
-        // cache info
-        Ort::Value cache_ort_{nullptr};
-        std::vector<float> cache_;
-
-        // set mdoel type.
-        int mmodel_type;
+        // cache ping-pong buffers, cache_[cur_cache_] is the next input
+        std::vector<float> cache_[2];
+        int cur_cache_ = 0;
+        // output rows of the last Forward()
+        wenet::AlignedVector<float> output_;
+        // scratch buffers of a native net
+        FsmnNet::Workspace fsmn_workspace_;
+#ifdef USE_ONNX
+        // Preallocated model inputs and outputs, bound by binding_.
+        Ort::MemoryInfo memory_info_{nullptr};
+        std::unique_ptr<Ort::IoBinding> binding_;
+        Ort::Value cache_ort_[2] = {Ort::Value{nullptr}, Ort::Value{nullptr}};
+        Ort::Value output_ort_{nullptr};
+        int output_frames_ = 0;
+        std::shared_ptr<BatchEngine> batch_engine_;
+#endif
 
         //set decoder type.
         DECODE_TYPE mdecode_type;
 
-        // vocab {token:index}
-        std::unordered_map<std::string, int> mvocab;
-        // keyword string
-        std::string  mkey_word ;
-        // keyword index set
-        std::unordered_set<int> mkeyword_set;
-        // keyword index list. handle same token in keyword.
-        std::vector<int> mkeyword_token;
-
         // CTC alignments.
         std::vector<Token> alignments;
         // set of hypotheses with greed search.
@@ -173,6 +179,9 @@ namespace wekws {
         int mGTimeStep = 0;
 
         bool activated = false;
+
+        // the last frames were skipped by SkipNonSpeech()
+        bool skipping_ = false;
     };
 
 
@@ -0,0 +1,125 @@
+// Copyright (c) 2022 Binbin Zhang (binbzha@qq.com)
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "kws/kws_model.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "utils/log.h"
+#include "utils/timer.h"
+
+namespace wekws {
+
+    std::shared_ptr<KwsModel> KwsModel::FromMappedFile(
+            const std::string &model_path, int model_type,
+            const KwsModelOptions &options) {
+        std::unique_ptr<wenet::MappedFile> file(new wenet::MappedFile);
+        if (!file->Open(model_path)) {
+            throw std::runtime_error("Failed to map model file: " + model_path);
+        }
+        // The native net copies its weights, the mapping is not kept.
+        if (FsmnNet::IsKaldiNet(file->data(), file->size())) {
+            wenet::Timer timer;
+            auto net = std::make_shared<const FsmnNet>(file->data(), file->size());
+            std::shared_ptr<KwsModel> model = std::make_shared<KwsModel>(net, model_type);
+            model->load_stats_.session_ms = timer.Elapsed() - model->load_stats_.metadata_ms;
+            model->PrintLoadStats();
+            return model;
+        }
+#ifdef USE_ONNX
+        return FromMappedOnnx(model_path, std::move(file), model_type, options);
+#else
+        (void)options;
+        throw std::runtime_error("Not a kaldi nnet, onnx models need a build "
+                                 "with -DONNX=ON: " + model_path);
+#endif
+    }
+
+    KwsModel::KwsModel(std::shared_ptr<const FsmnNet> net, int model_type)
+            : fsmn_net_(std::move(net)), model_type_(model_type) {
+        wenet::Timer timer;
+        // The cache of the memory blocks is flat, its layout is private to
+        // the net.
+        cache_size_ = fsmn_net_->cache_size();
+        cache_shape_ = {1, static_cast<int64_t>(cache_size_)};
+        output_dim_ = fsmn_net_->output_dim();
+        load_stats_.metadata_ms = timer.Elapsed();
+        load_stats_.total_ms = load_stats_.metadata_ms;
+        std::cout << "Kws Model Info:" << std::endl
+                  << "\tbackend: native fsmn" << std::endl
+                  << "\tfsmn layers: " << fsmn_net_->num_fsmn_layers() << std::endl
+                  << "\tcache_len: " << fsmn_net_->cache_len() << std::endl;
+    }
+
+    void KwsModel::PrintLoadStats() {
+        load_stats_.total_ms = load_stats_.env_ms + load_stats_.session_ms +
+                               load_stats_.metadata_ms;
+        std::cout << "Kws Model Load (ms):" << std::endl
+                  << "\tfrom optimized cache: " << load_stats_.from_optimized_cache << std::endl
+                  << "\tenv: " << load_stats_.env_ms << std::endl
+                  << "\tsession: " << load_stats_.session_ms << std::endl
+                  << "\tmetadata: " << load_stats_.metadata_ms << std::endl
+                  << "\ttotal: " << load_stats_.total_ms << std::endl;
+    }
+
+    void KwsModel::readToken(const std::string &tokenFile) {
+        std::ifstream fin(tokenFile);
+
+        if (fin.is_open()) {
+            std::string line;
+            while (std::getline(fin, line)) {
+                if(model_type_==1){
+                    std::string token;
+                    int value;
+                    std::istringstream iss(line);
+                    if (iss >> token >> value) {
+                        vocab_[token] = value - 1;
+                    }
+                }else{
+                    maxpooling_keywords_.push_back(line);
+                }
+            }
+            fin.close();
+        } else {
+            std::cerr << "Error: Unable to open the token file." << std::endl;
+        }
+
+    }
+
+    void KwsModel::setKeyWord(const std::string &keyWord) {
+        /*keyWord : key word to wakeup.
+         * */
+        key_word_ = keyWord;
+        keyword_set_.insert(0);  // insert 0 for blank token of ctc.
+        for (int idx = 0; idx < keyWord.size(); idx += 3) { // 3byte for chinese char with utf8.
+            std::string token = keyWord.substr(idx, 3);
+            int toekn_idx = vocab_.at(token);
+            if (vocab_.count(token) > 0) {
+                if (keyword_set_.count(toekn_idx) == 0) {
+                    keyword_set_.insert(toekn_idx);
+                }
+                keyword_token_.push_back(toekn_idx);
+            } else {
+                std::cerr << "Can not find" << " " << keyWord << " " << "in vocab. Please check.";
+            }
+        }
+    }
+
+}  // namespace wekws
@@ -0,0 +1,183 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KWS_KWS_MODEL_H_
+#define KWS_KWS_MODEL_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef USE_ONNX
+#include "onnxruntime_cxx_api.h"  // NOLINT
+#endif
+#include "kws/fsmn_net.h"
+#include "utils/mapped_file.h"
+
+namespace wekws {
+
+    // Options of the onnx models, a native net has none.
+    struct KwsModelOptions {
+#ifdef USE_ONNX
+        GraphOptimizationLevel graph_optimization_level = ORT_ENABLE_ALL;
+#endif
+        // Cache of the optimized graph, empty to optimize on every load. It
+        // is written by the first load, then loaded instead of the model
+        // as long as it is newer than the model file. The onnxruntime
+        // version and graph_optimization_level are added to the file name,
+        // so a cache of another version or level is never loaded. A .ort
+        // path saves it in the ORT format, the fastest to load.
+        std::string optimized_model_path;
+        // Share the prepacked weights of the GEMMs with the other sessions
+        // of the process loading the same weights, see KwsRuntime.
+        bool share_prepacked_weights = true;
+    };
+
+    // Cold start time of a model, in milliseconds.
+    struct KwsModelLoadStats {
+        // the model was loaded from its optimized cache
+        bool from_optimized_cache = false;
+        // onnxruntime env and thread pools, only paid by the first model
+        double env_ms = 0.0;
+        // read, optimize and, on a cache miss, save the graph
+        double session_ms = 0.0;
+        // meta info and output shape
+        double metadata_ms = 0.0;
+        double total_ms = 0.0;
+    };
+
+    // The immutable part of a keyword spotter: the onnx session, its meta
+    // info, the vocab and the keyword. It is loaded once and shared by the
+    // KwsStream of every stream. Call readToken() and setKeyWord() before
+    // the streams are created, the model is then only read, and the session
+    // Run() is thread safe. Sessions run on the thread pools of KwsRuntime.
+    // An FSMN exported as a Kaldi nnet runs natively on a FsmnNet instead
+    // of a session, the only backend of a build without onnxruntime
+    // (-DONNX=OFF).
+    class KwsModel {
+    public:
+        KwsModel(std::shared_ptr<const FsmnNet> net, int model_type);
+
+        // Load the model from a read-only mapping of model_path, or of its
+        // optimized graph cache, without reading it into a buffer first.
+        // Only an ORT format graph is then read in place, its pages shared
+        // by the processes mapping it through the page cache, so use .ort
+        // models when the memory matters. Its initializers are still
+        // copied to tensors before onnxruntime 1.14. The session copies
+        // onnx bytes, their mapping is released once it is created. A Kaldi
+        // nnet of export_kaldi_net.py is loaded as a native FsmnNet.
+        static std::shared_ptr<KwsModel> FromMappedFile(
+                const std::string &model_path, int model_type,
+                const KwsModelOptions &options = KwsModelOptions());
+
+#ifdef USE_ONNX
+        KwsModel(const std::string &model_path, int model_type,
+                 const KwsModelOptions &options = KwsModelOptions());
+
+        // Load the model from model_size bytes, e.g. a model embedded in
+        // the binary. The graph of ORT format bytes is used in place, they
+        // must outlive the model, onnx ones are copied.
+        KwsModel(const void *model_data, size_t model_size, int model_type,
+                 const KwsModelOptions &options = KwsModelOptions());
+
+        KwsModel(std::shared_ptr<Ort::Session> session, int model_type);
+
+        // onnx session, null for a native net
+        Ort::Session *session() const { return session_.get(); }
+#endif
+
+        KwsModel(const KwsModel &) = delete;
+        KwsModel &operator=(const KwsModel &) = delete;
+
+        // load vocab from token.txt, or the keywords of a max-pooling model
+        void readToken(const std::string &tokenFile);
+
+        // set keyword, for the ctc models
+        void setKeyWord(const std::string &keyWord);
+
+        // native net, null for an onnx model
+        const FsmnNet *fsmn_net() const { return fsmn_net_.get(); }
+        const KwsModelLoadStats &load_stats() const { return load_stats_; }
+        int model_type() const { return model_type_; }
+
+        // shape of the cache of one stream, batch axis first
+        const std::vector<int64_t> &cache_shape() const { return cache_shape_; }
+        size_t cache_size() const { return cache_size_; }
+
+        // vocab size of the ctc models, number of keywords otherwise
+        int output_dim() const { return output_dim_; }
+
+        // "int8_dynamic" or "int8_static" for the int8 models of
+        // quantize_onnx.py, empty for a float model
+        const std::string &quantization() const { return quantization_; }
+        bool is_quantized() const { return !quantization_.empty(); }
+
+        const std::string &keyword() const { return key_word_; }
+        // keyword token indices, a token may repeat
+        const std::vector<int> &keyword_token() const { return keyword_token_; }
+        bool has_keyword() const { return !keyword_set_.empty(); }
+        // Token is keyword or blank.
+        bool isKeyword(int index) const { return keyword_set_.count(index) > 0; }
+
+        const std::vector<std::string> &maxpooling_keywords() const {
+            return maxpooling_keywords_;
+        }
+
+    private:
+        void PrintLoadStats();
+
+#ifdef USE_ONNX
+        // FromMappedFile() of an onnx or ORT format file.
+        static std::shared_ptr<KwsModel> FromMappedOnnx(
+                const std::string &model_path, std::unique_ptr<wenet::MappedFile> file,
+                int model_type, const KwsModelOptions &options);
+
+        // Read the meta info of session_.
+        void Init();
+
+        // mapping of an ORT format model of FromMappedFile(), used in place
+        // by the session, so declared first to be unmapped after it
+        std::unique_ptr<wenet::MappedFile> model_file_;
+        // onnx runtime session
+        std::shared_ptr<Ort::Session> session_;
+#endif
+        std::shared_ptr<const FsmnNet> fsmn_net_;
+
+        int model_type_;
+        KwsModelLoadStats load_stats_;
+
+        // meta info
+        std::vector<int64_t> cache_shape_;
+        size_t cache_size_ = 0;
+        int output_dim_ = 0;
+        std::string quantization_;
+
+        // vocab {token:index}
+        std::unordered_map<std::string, int> vocab_;
+        // keyword string
+        std::string key_word_;
+        // keyword index set
+        std::unordered_set<int> keyword_set_;
+        // keyword index list. handle same token in keyword.
+        std::vector<int> keyword_token_;
+        // maxpooling keywords
+        std::vector<std::string> maxpooling_keywords_;
+    };
+
+}  // namespace wekws
+
+#endif  // KWS_KWS_MODEL_H_
@@ -0,0 +1,284 @@
+// Copyright (c) 2022 Binbin Zhang (binbzha@qq.com)
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// The onnxruntime backend of KwsModel, built with -DONNX=ON.
+
+#include "kws/kws_model.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "kws/kws_runtime.h"
+#include "utils/log.h"
+#include "utils/timer.h"
+
+namespace wekws {
+
+    namespace {
+
+        bool IsOrtFormat(const std::string &path) {
+            return boost::filesystem::path(path).extension() == ".ort";
+        }
+
+        // ORT format bytes, the flatbuffer identifier is at offset 4.
+        bool IsOrtBytes(const void *data, size_t size) {
+            return size >= 8 &&
+                   memcmp(static_cast<const char *>(data) + 4, "ORTM", 4) == 0;
+        }
+
+        // Insert tag before the extension of path.
+        std::string TagPath(const std::string &path, const std::string &tag) {
+            boost::filesystem::path p(path);
+            return (p.parent_path() /
+                    (p.stem().string() + tag + p.extension().string())).string();
+        }
+
+        // The optimized graph depends on the onnxruntime version and the
+        // optimization level, both are part of the cache file name, e.g.
+        // model.opt.ort is cached as model.opt-ort1.12.0-O99.ort.
+        std::string OptimizedCachePath(const KwsModelOptions &options) {
+            if (options.optimized_model_path.empty()) return "";
+            return TagPath(options.optimized_model_path,
+                           std::string("-ort") + OrtGetApiBase()->GetVersionString() +
+                           "-O" + std::to_string(static_cast<int>(
+                                   options.graph_optimization_level)));
+        }
+
+        // The optimized graph cache of model_path exists and is up to date.
+        bool HasOptimizedCache(const std::string &model_path,
+                               const std::string &cache_path) {
+            boost::system::error_code ec;
+            return !cache_path.empty() &&
+                   boost::filesystem::exists(cache_path, ec) &&
+                   boost::filesystem::last_write_time(cache_path, ec) >=
+                   boost::filesystem::last_write_time(model_path, ec) && !ec;
+        }
+
+        // The session saves the optimized graph to a temporary file of this
+        // process, renamed to the cache by Commit() once the session is
+        // created. A concurrent load never maps a partial cache, and the
+        // file is removed when the session fails.
+        class CacheWriter {
+        public:
+            explicit CacheWriter(const std::string &cache_path)
+                    : cache_path_(cache_path) {
+                static std::atomic<int> count(0);
+                if (!cache_path_.empty()) {
+                    tmp_path_ = TagPath(cache_path_, ".tmp" + std::to_string(getpid()) +
+                                                     "-" + std::to_string(count++));
+                }
+            }
+
+            ~CacheWriter() {
+                if (!tmp_path_.empty()) remove(tmp_path_.c_str());
+            }
+
+            // empty when no cache is saved
+            const std::string &tmp_path() const { return tmp_path_; }
+
+            void Commit() {
+                if (tmp_path_.empty()) return;
+                if (rename(tmp_path_.c_str(), cache_path_.c_str()) == 0) {
+                    tmp_path_.clear();
+                } else {
+                    LOG(WARNING) << "Failed to save the optimized graph to " << cache_path_;
+                }
+            }
+
+        private:
+            std::string cache_path_;
+            std::string tmp_path_;
+        };
+
+        // Options of a session loading the optimized graph cache_path or,
+        // when it is empty, optimizing the model and saving the graph to
+        // save_path unless it is empty too.
+        Ort::SessionOptions MakeSessionOptions(const KwsModelOptions &options,
+                                               const std::string &cache_path,
+                                               const std::string &save_path) {
+            Ort::SessionOptions session_options = KwsRuntime::session_options().Clone();
+            if (!cache_path.empty()) {
+                // the graph is already optimized
+                session_options.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+                if (IsOrtFormat(cache_path)) {
+                    session_options.AddConfigEntry("session.load_model_format", "ORT");
+                }
+            } else {
+                session_options.SetGraphOptimizationLevel(options.graph_optimization_level);
+                if (!save_path.empty()) {
+                    session_options.SetOptimizedModelFilePath(save_path.c_str());
+                    if (IsOrtFormat(save_path)) {
+                        session_options.AddConfigEntry("session.save_model_format", "ORT");
+                    }
+                }
+            }
+            return session_options;
+        }
+
+    }  // namespace
+
+    KwsModel::KwsModel(const std::string &model_path, int model_type,
+                       const KwsModelOptions &options)
+            : model_type_(model_type) {
+        wenet::Timer timer;
+        Ort::Env &env = KwsRuntime::env();
+        load_stats_.env_ms = timer.Elapsed();
+
+        // Load onnx runtime sessions, from the optimized graph cache when it
+        // is up to date.
+        timer.Reset();
+        const std::string cache_path = OptimizedCachePath(options);
+        load_stats_.from_optimized_cache = HasOptimizedCache(model_path, cache_path);
+        const std::string &path = load_stats_.from_optimized_cache ?
+                                  cache_path : model_path;
+        CacheWriter cache_writer(load_stats_.from_optimized_cache ? "" : cache_path);
+        Ort::SessionOptions session_options = MakeSessionOptions(
+                options, load_stats_.from_optimized_cache ? cache_path : "",
+                cache_writer.tmp_path());
+        if (options.share_prepacked_weights) {
+            session_ = std::make_shared<Ort::Session>(
+                    env, path.c_str(), session_options,
+                    KwsRuntime::prepacked_weights());
+        } else {
+            session_ = std::make_shared<Ort::Session>(env, path.c_str(),
+                                                      session_options);
+        }
+        cache_writer.Commit();
+        load_stats_.session_ms = timer.Elapsed();
+        Init();
+        PrintLoadStats();
+    }
+
+    KwsModel::KwsModel(const void *model_data, size_t model_size,
+                       int model_type, const KwsModelOptions &options)
+            : model_type_(model_type) {
+        wenet::Timer timer;
+        Ort::Env &env = KwsRuntime::env();
+        load_stats_.env_ms = timer.Elapsed();
+
+        timer.Reset();
+        CacheWriter cache_writer(OptimizedCachePath(options));
+        Ort::SessionOptions session_options =
+                MakeSessionOptions(options, "", cache_writer.tmp_path());
+        // The graph of an ORT format model is read in place rather than
+        // copied. Its initializers are copied to tensors all the same
+        // until onnxruntime 1.14, which can also use them in place.
+        if (IsOrtBytes(model_data, model_size)) {
+            session_options.AddConfigEntry("session.load_model_format", "ORT");
+            session_options.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+#if ORT_API_VERSION >= 14
+            session_options.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+#endif
+        }
+        if (options.share_prepacked_weights) {
+            session_ = std::make_shared<Ort::Session>(
+                    env, model_data, model_size, session_options,
+                    KwsRuntime::prepacked_weights());
+        } else {
+            session_ = std::make_shared<Ort::Session>(env, model_data, model_size,
+                                                      session_options);
+        }
+        cache_writer.Commit();
+        load_stats_.session_ms = timer.Elapsed();
+        Init();
+        PrintLoadStats();
+    }
+
+    std::shared_ptr<KwsModel> KwsModel::FromMappedOnnx(
+            const std::string &model_path, std::unique_ptr<wenet::MappedFile> file,
+            int model_type, const KwsModelOptions &options) {
+        // Map the optimized graph cache instead when it is up to date, it
+        // is then loaded as is.
+        const std::string cache_path = OptimizedCachePath(options);
+        const bool from_cache = HasOptimizedCache(model_path, cache_path);
+        KwsModelOptions load_options(options);
+        if (from_cache) {
+            load_options.graph_optimization_level = ORT_DISABLE_ALL;
+            load_options.optimized_model_path.clear();
+            if (!file->Open(cache_path)) {
+                throw std::runtime_error("Failed to map model file: " + cache_path);
+            }
+        }
+        std::shared_ptr<KwsModel> model = std::make_shared<KwsModel>(
+                file->data(), file->size(), model_type, load_options);
+        model->load_stats_.from_optimized_cache = from_cache;
+        // The session reads an ORT format graph in place, it copied onnx
+        // bytes and their mapping is released.
+        if (IsOrtBytes(file->data(), file->size())) {
+            model->model_file_ = std::move(file);
+        }
+        return model;
+    }
+
+    KwsModel::KwsModel(std::shared_ptr<Ort::Session> session, int model_type)
+            : session_(std::move(session)), model_type_(model_type) {
+        Init();
+        load_stats_.total_ms = load_stats_.metadata_ms;
+    }
+
+    void KwsModel::Init() {
+        wenet::Timer timer;
+        // Model info. Information can be view from netron.
+        // pip install netron. netron [model_path]
+        auto metadata = session_->GetModelMetadata();
+        Ort::AllocatorWithDefaultOptions allocator;
+        int cache_dim = std::stoi(metadata.LookupCustomMetadataMap("cache_dim",
+                                                                   allocator));
+        int cache_len = std::stoi(metadata.LookupCustomMetadataMap("cache_len",
+                                                                   allocator));
+        cache_shape_ = {1, cache_dim, cache_len};
+        if (model_type_ == 1) cache_shape_.push_back(4);  // ctc model
+        cache_size_ = 1;
+        for (int64_t dim : cache_shape_) cache_size_ *= dim;
+        // int8 models of quantize_onnx.py are marked as such, their inputs
+        // and outputs stay float.
+        char *quantization = metadata.LookupCustomMetadataMap("quantization",
+                                                              allocator);
+        if (quantization != nullptr) {
+            quantization_ = quantization;
+            allocator.Free(quantization);
+        }
+        for (size_t i = 0; i < session_->GetInputCount(); i++) {
+            if (session_->GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetElementType() !=
+                ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+                throw std::runtime_error("Model input " + std::to_string(i) + " is not float");
+            }
+        }
+        for (size_t i = 0; i < session_->GetOutputCount(); i++) {
+            if (session_->GetOutputTypeInfo(i).GetTensorTypeAndShapeInfo().GetElementType() !=
+                ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+                throw std::runtime_error("Model output " + std::to_string(i) + " is not float");
+            }
+        }
+        // the last output dim, vocab size or number of keywords
+        output_dim_ = session_->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape().back();
+        CHECK(output_dim_ > 0);
+        load_stats_.metadata_ms = timer.Elapsed();
+        std::cout << "Kws Model Info:" << std::endl
+                  << "\tcache_dim: " << cache_dim << std::endl
+                  << "\tcache_len: " << cache_len << std::endl
+                  << "\tquantization: " << (is_quantized() ? quantization_ : "fp32") << std::endl;
+    }
+
+}  // namespace wekws
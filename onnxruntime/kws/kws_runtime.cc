@@ -0,0 +1,145 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "kws/kws_runtime.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "utils/log.h"
+
+namespace wekws {
+
+    namespace {
+
+        // Pool threads created by onnxruntime through CreateThread(), to
+        // pin them to the configured cores.
+        struct ThreadAffinity {
+            std::vector<int> cpus;
+            std::atomic<size_t> next{0};
+        };
+
+        OrtCustomThreadHandle CreateThread(void *options, OrtThreadWorkerFn fn,
+                                           void *param) {
+            ThreadAffinity *affinity = static_cast<ThreadAffinity *>(options);
+            std::thread *thread = new std::thread(fn, param);
+            int cpu = affinity->cpus[affinity->next++ % affinity->cpus.size()];
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu, &cpu_set);
+            if (pthread_setaffinity_np(thread->native_handle(), sizeof(cpu_set),
+                                       &cpu_set) != 0) {
+                LOG(WARNING) << "Failed to pin an onnxruntime thread to cpu " << cpu;
+            }
+            return reinterpret_cast<OrtCustomThreadHandle>(thread);
+        }
+
+        void JoinThread(OrtCustomThreadHandle handle) {
+            std::thread *thread = const_cast<std::thread *>(
+                    reinterpret_cast<const std::thread *>(handle));
+            thread->join();
+            delete thread;
+        }
+
+        struct Runtime {
+            explicit Runtime(const KwsRuntimeConfig &config);
+
+            ThreadAffinity affinity;
+            Ort::Env env{nullptr};
+            Ort::SessionOptions session_options;
+            Ort::PrepackedWeightsContainer prepacked_weights;
+        };
+
+        Runtime::Runtime(const KwsRuntimeConfig &config) {
+            const OrtApi &api = Ort::GetApi();
+            // 1. Global thread pools, shared by all the sessions.
+            OrtThreadingOptions *threading_options = nullptr;
+            Ort::ThrowOnError(api.CreateThreadingOptions(&threading_options));
+            Ort::ThrowOnError(api.SetGlobalIntraOpNumThreads(
+                    threading_options, config.intra_op_num_threads));
+            Ort::ThrowOnError(api.SetGlobalInterOpNumThreads(
+                    threading_options, config.inter_op_num_threads));
+            Ort::ThrowOnError(api.SetGlobalSpinControl(
+                    threading_options, config.allow_spinning ? 1 : 0));
+            if (!config.cpu_affinity.empty()) {
+                affinity.cpus = config.cpu_affinity;
+                Ort::ThrowOnError(api.SetGlobalCustomCreateThreadFn(
+                        threading_options, CreateThread));
+                Ort::ThrowOnError(api.SetGlobalCustomThreadCreationOptions(
+                        threading_options, &affinity));
+                Ort::ThrowOnError(api.SetGlobalCustomJoinThreadFn(
+                        threading_options, JoinThread));
+            }
+            env = Ort::Env(threading_options, ORT_LOGGING_LEVEL_WARNING, "");
+            api.ReleaseThreadingOptions(threading_options);
+
+            // 2. Sessions run on the global pools rather than their own.
+            session_options.DisablePerSessionThreads();
+
+            // 3. One cpu arena registered in the env, used by the sessions
+            // instead of an arena each.
+            if (config.shared_arena) {
+                OrtArenaCfg *arena_cfg = nullptr;
+                // -1 keeps the default extend strategy and chunk sizes
+                Ort::ThrowOnError(api.CreateArenaCfg(config.arena_max_memory,
+                                                     -1, -1, -1, &arena_cfg));
+                Ort::MemoryInfo memory_info("Cpu", OrtArenaAllocator, 0,
+                                            OrtMemTypeDefault);
+                env.CreateAndRegisterAllocator(memory_info, arena_cfg);
+                api.ReleaseArenaCfg(arena_cfg);
+                session_options.AddConfigEntry("session.use_env_allocators", "1");
+            }
+        }
+
+        std::mutex runtime_mutex;
+        std::unique_ptr<Runtime> runtime;
+
+        Runtime &GetRuntime() {
+            std::lock_guard<std::mutex> lock(runtime_mutex);
+            if (runtime == nullptr) runtime.reset(new Runtime(KwsRuntimeConfig()));
+            return *runtime;
+        }
+
+    }  // namespace
+
+    bool KwsRuntime::Init(const KwsRuntimeConfig &config) {
+        std::lock_guard<std::mutex> lock(runtime_mutex);
+        if (runtime != nullptr) {
+            LOG(WARNING) << "The onnxruntime environment is already created, "
+                         << "its config is not changed";
+            return false;
+        }
+        runtime.reset(new Runtime(config));
+        return true;
+    }
+
+    Ort::Env &KwsRuntime::env() {
+        return GetRuntime().env;
+    }
+
+    const Ort::SessionOptions &KwsRuntime::session_options() {
+        return GetRuntime().session_options;
+    }
+
+    Ort::PrepackedWeightsContainer &KwsRuntime::prepacked_weights() {
+        return GetRuntime().prepacked_weights;
+    }
+
+}  // namespace wekws
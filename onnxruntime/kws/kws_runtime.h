@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KWS_KWS_RUNTIME_H_
+#define KWS_KWS_RUNTIME_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "onnxruntime_cxx_api.h"  // NOLINT
+
+namespace wekws {
+
+    struct KwsRuntimeConfig {
+        // threads of the global intra-op and inter-op pools, 0 lets
+        // onnxruntime pick one per physical core
+        int intra_op_num_threads = 0;
+        int inter_op_num_threads = 1;
+        // Idle pool threads spin a while before they sleep. It saves the
+        // wake up latency of the next run, at the cost of burning cpu.
+        bool allow_spinning = false;
+        // Cores the pool threads are pinned to, one per thread round robin.
+        // Empty leaves the threads to the os scheduler.
+        std::vector<int> cpu_affinity;
+        // Sessions allocate from one shared cpu arena instead of one arena
+        // each. arena_max_memory caps it in bytes, 0 is no limit.
+        bool shared_arena = true;
+        size_t arena_max_memory = 0;
+    };
+
+    // The process wide onnxruntime environment shared by every KwsModel:
+    // one Ort::Env owning the global thread pools, so that N models do not
+    // each create their own, the base options of their sessions and their
+    // prepacked weights.
+    class KwsRuntime {
+    public:
+        // Configure the runtime, before the first model is loaded. Without
+        // it, the first model creates the runtime with the defaults.
+        // Return false if the runtime already exists.
+        static bool Init(const KwsRuntimeConfig &config);
+
+        static Ort::Env &env();
+
+        // Options of the sessions, using the global thread pools and the
+        // shared arena. Copy them to add options of a session.
+        static const Ort::SessionOptions &session_options();
+
+        // Prepacked weights shared by the sessions created with it, so
+        // that sessions of the same weights, e.g. one model per keyword,
+        // keep one copy of them.
+        static Ort::PrepackedWeightsContainer &prepacked_weights();
+    };
+
+}  // namespace wekws
+
+#endif  // KWS_KWS_RUNTIME_H_
@@ -18,6 +18,10 @@
 
 #include "kws/utils.h"
 
+#include <fstream>
+#include <sstream>
+#include <utility>
+
 
 namespace wekws {
 
@@ -33,10 +37,9 @@ namespace wekws {
     // We refer the pytorch topk implementation
     // https://github.com/pytorch/pytorch/blob/master/caffe2/operators/top_k.cc
     template <typename T>
-    void TopK(const std::vector<T>& data, int32_t k, std::vector<T>* values,
+    void TopK(const T* data, int n, int32_t k, std::vector<T>* values,
               std::vector<int>* indices) {
         std::vector<std::pair<T, int32_t>> heap_data;
-        int n = data.size();
         for (int32_t i = 0; i < k && i < n; ++i) {
             heap_data.emplace_back(data[i], i);
         }
@@ -62,7 +65,7 @@ namespace wekws {
         }
     }
 
-    template void TopK<float>(const std::vector<float>& data, int32_t k,
+    template void TopK<float>(const float* data, int n, int32_t k,
                               std::vector<float>* values,
                               std::vector<int>* indices);
 
@@ -88,9 +91,7 @@ namespace wekws {
         const int16_t* pcm_data_ptr = reinterpret_cast<const int16_t*>(pcm_data.data());
         int sample_count = file_size / sizeof(int16_t);
 
-        for (int i = 0; i < sample_count; ++i) {
-            pcm_float.push_back(static_cast<float>(pcm_data_ptr[i]));
-        }
+        pcm_float.insert(pcm_float.end(), pcm_data_ptr, pcm_data_ptr + sample_count);
     }
 
     void process_directory(const boost::filesystem::path &dirpath, std::vector<std::string> &wavePaths) {
@@ -109,6 +110,24 @@ namespace wekws {
         }
     }
 
+    void read_manifest(const std::string& manifest_path, std::vector<ManifestEntry>& entries) {
+        std::ifstream manifest(manifest_path);
+        if (!manifest.is_open()) {
+            throw std::runtime_error("Failed to open file:" + manifest_path); // 抛出异常
+        }
+        std::string line;
+        while (std::getline(manifest, line)) {
+            std::istringstream fields(line);
+            ManifestEntry entry;
+            if (!(fields >> entry.key) || entry.key[0] == '#') continue;
+            if (!(fields >> entry.path)) {
+                throw std::runtime_error("No path in manifest line:" + line);
+            }
+            std::getline(fields >> std::ws, entry.label);
+            entries.push_back(std::move(entry));
+        }
+    }
+
     void writeVectorToFile(const std::vector<std::string>& data, const std::string& filename) {
         std::ofstream file(filename);
 
@@ -27,13 +27,30 @@
 namespace wekws {
 
     template <typename T>
-    void TopK(const std::vector<T>& data, int32_t k, std::vector<T>* values,
+    void TopK(const T* data, int n, int32_t k, std::vector<T>* values,
               std::vector<int>* indices);
 
+    template <typename T>
+    void TopK(const std::vector<T>& data, int32_t k, std::vector<T>* values,
+              std::vector<int>* indices) {
+        TopK(data.data(), static_cast<int>(data.size()), k, values, indices);
+    }
+
     void read_pcm(const std::string& file_path, std::vector<float>& pcm_float);
 
     void process_directory(const boost::filesystem::path &dirpath, std::vector<std::string> &wavePaths);
 
+    // One utterance of an evaluation manifest.
+    struct ManifestEntry {
+        std::string key;
+        std::string path;
+        std::string label;  // may be empty
+    };
+
+    // Read a manifest of "key path [label]" lines, the label is the rest of
+    // the line. Empty lines and lines starting with # are skipped.
+    void read_manifest(const std::string& manifest_path, std::vector<ManifestEntry>& entries);
+
     void writeVectorToFile(const std::vector<std::string>& data, const std::string& filename);
 }  // namespace wekws
 
@@ -0,0 +1,130 @@
+# Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Writes tiny_fsmn.nnet, a small random fsmn ctc net in the kaldi nnet text
+of FSMN.to_kaldi_net() and export_kaldi_net.py, with an input and the
+reference output of a whole utterance, for fsmn_net_test.
+
+The layers mirror model_convert/model/fsmn.py in numpy, so the data is
+regenerated without torch:  python gen_tiny_fsmn.py
+"""
+
+import numpy as np
+
+np.random.seed(777)
+
+# input, affine, fsmn layers, linear, proj, output dims
+I, A, N, LIN, PROJ, O = 8, 12, 2, 16, 9, 6
+# orders and strides of the memory blocks
+LORDER, RORDER, LSTRIDE, RSTRIDE = 4, 2, 2, 1
+T = 40
+
+
+def toKaldiMatrix(np_mat):
+    np.set_printoptions(threshold=np.inf, linewidth=np.nan)
+    out_str = str(np_mat)
+    out_str = out_str.replace('[', '').replace(']', '')
+    return '[ %s ]\n' % out_str
+
+
+def rand(*shape):
+    return (np.random.randn(*shape) * 0.3).astype(np.float32)
+
+
+def cmvn(dim):
+    mean, istd = rand(dim), np.abs(rand(dim)) + 0.5
+    text = '<AddShift> %d %d\n' % (dim, dim)
+    text += '<LearnRateCoef> 0 ' + toKaldiMatrix(-mean)
+    text += '<Rescale> %d %d\n' % (dim, dim)
+    text += '<LearnRateCoef> 0 ' + toKaldiMatrix(istd)
+    return text, lambda x: (x - mean) * istd
+
+
+def affine(i, o):
+    w, b = rand(o, i), rand(o)
+    text = '<AffineTransform> %d %d\n' % (o, i)
+    text += '<LearnRateCoef> 1 <BiasLearnRateCoef> 1 <MaxNorm> 0\n'
+    text += toKaldiMatrix(w) + toKaldiMatrix(b)
+    return text, lambda x: x @ w.T + b
+
+
+def linear(i, o):
+    w = rand(o, i)
+    text = '<LinearTransform> %d %d\n' % (o, i)
+    text += '<LearnRateCoef> 1\n' + toKaldiMatrix(w)
+    return text, lambda x: x @ w.T
+
+
+def relu(dim):
+    return ('<RectifiedLinear> %d %d\n' % (dim, dim),
+            lambda x: np.maximum(x, 0))
+
+
+def fsmn(dim):
+    # conv_left / conv_right weights, tap k of the left filter weights the
+    # frame (lorder - 1 - k) * lstride before the current one, tap k of the
+    # right filter the frame (k + 1) * rstride after it
+    wl, wr = rand(dim, LORDER), rand(dim, RORDER)
+    text = '<Fsmn> %d %d\n' % (dim, dim)
+    text += ('<LearnRateCoef> %d <LOrder> %d <ROrder> %d <LStride> %d '
+             '<RStride> %d <MaxNorm> 0\n' %
+             (1, LORDER, RORDER, LSTRIDE, RSTRIDE))
+    text += toKaldiMatrix(np.flipud(wl.T))
+    if RORDER > 0:
+        text += toKaldiMatrix(wr.T)
+
+    left, right = (LORDER - 1) * LSTRIDE, RORDER * RSTRIDE
+
+    # The streaming onnx model is delayed by right frames: output t is the
+    # memory of input frame t - right, zeros before the first frame.
+    def forward(x):
+        xp = np.concatenate(
+            [np.zeros((left + right, dim), np.float32), x])
+        out = xp[left:left + T].copy()
+        for t in range(T):
+            c = t + left
+            for k in range(LORDER):
+                out[t] += wl[:, k] * xp[c - (LORDER - 1 - k) * LSTRIDE]
+            for k in range(RORDER):
+                out[t] += wr[:, k] * xp[c + (k + 1) * RSTRIDE]
+        return out
+    return text, forward
+
+
+def softmax(dim):
+    def forward(x):
+        e = np.exp(x - x.max(1, keepdims=True))
+        return e / e.sum(1, keepdims=True)
+    return '<Softmax> %d %d\n' % (dim, dim), forward
+
+
+def main():
+    layers = [cmvn(I), affine(I, A), affine(A, LIN), relu(LIN)]
+    for _ in range(N):
+        layers += [linear(LIN, PROJ), fsmn(PROJ), affine(PROJ, LIN),
+                   relu(LIN)]
+    layers += [affine(LIN, O), softmax(O)]
+
+    x = rand(T, I) * 3
+    y = x
+    for _, forward in layers:
+        y = forward(y)
+    with open('tiny_fsmn.nnet', 'w') as fout:
+        fout.write('<Nnet>\n' + ''.join(t for t, _ in layers) + '</Nnet>\n')
+    np.savetxt('tiny_fsmn_input.txt', x, fmt='%.8e')
+    np.savetxt('tiny_fsmn_output.txt', y, fmt='%.8e')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writes a feature archive and reads it back, plain and compressed, and
+// checks that it is only opened for the pipeline config it was written with.
+//
+// Usage: feature_archive_test tmp_dir
+
+#include <cmath>
+#include <string>
+
+#include "frontend/feature_archive.h"
+#include "frontend/feature_pipeline.h"
+#include "utils/log.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    LOG(FATAL) << "Usage: feature_archive_test tmp_dir";
+  }
+  wenet::FeaturePipelineConfig config(40, 16000, wenet::CTC_TYPE_MODEL);
+  const wenet::FeatureArchiveConfig archive_config(config);
+  wenet::FeatureMatrix feats(7, 200);
+  for (int i = 0; i < feats.size(); ++i) feats.data()[i] = std::sin(0.1f * i);
+
+  for (bool compress : {false, true}) {
+    const std::string path = std::string(argv[1]) + "/feats" +
+                             (compress ? "_compressed" : "") + ".ark";
+    wenet::FeatureArchiveWriter writer;
+    CHECK(writer.Open(path, archive_config, compress));
+    CHECK(writer.Write("utt1", feats));
+    CHECK(writer.Write("utt2", wenet::FeatureView(feats).Rows(2, 3)));
+    CHECK(writer.Close());
+
+    wenet::FeatureArchiveReader reader;
+    CHECK(reader.Open(path, archive_config));
+    CHECK(reader.config() == archive_config);
+    CHECK(reader.keys().size() == 2 && reader.keys()[0] == "utt1");
+    wenet::FeatureMatrix buffer;
+    wenet::FeatureView view;
+    CHECK(reader.Get("utt2", &buffer, &view));
+    CHECK(view.num_rows() == 3 && view.num_cols() == 200);
+    const float tolerance = compress ? 2.0f / 255 : 0.0f;
+    for (int i = 0; i < view.size(); ++i) {
+      CHECK(std::fabs(view.data()[i] - feats.Row(2)[i]) <= tolerance);
+    }
+
+    // another frontend
+    wenet::FeaturePipelineConfig other = config;
+    other.downsampling = 2;
+    CHECK(!reader.Open(path, wenet::FeatureArchiveConfig(other)));
+    CHECK(!reader.Contains("utt1"));
+    other = config;
+    other.num_bins = 80;
+    CHECK(!reader.Open(path, wenet::FeatureArchiveConfig(other)));
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Feeds one waveform to the ctc FeaturePipeline whole and in chunks of
+// several sizes, the spliced and downsampled frames must not depend on how
+// the wav is chunked, nor on the sample type of multi-channel wav. Then
+// checks the vad pre-roll ahead of a speech onset.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "frontend/feature_matrix.h"
+#include "frontend/feature_pipeline.h"
+#include "utils/log.h"
+
+namespace {
+
+// 1.3 s of a chirp under noise, fixed across runs.
+std::vector<int16_t> MakeWav(int sample_rate) {
+  const int num_samples = sample_rate * 13 / 10;
+  std::vector<int16_t> wav(num_samples);
+  uint32_t seed = 12345;
+  for (int i = 0; i < num_samples; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    float noise = static_cast<float>(seed >> 16) / 65536.0f - 0.5f;
+    float t = static_cast<float>(i) / sample_rate;
+    float tone = std::sin(2.0f * M_PI * (200.0f + 800.0f * t) * t);
+    wav[i] = static_cast<int16_t>(8000.0f * tone + 2000.0f * noise);
+  }
+  return wav;
+}
+
+// All the frames of wav fed chunk_size samples at a time, the whole wav at
+// once when chunk_size is 0.
+template <typename T>
+wenet::FeatureMatrix Extract(const wenet::FeaturePipelineConfig &config,
+                             const std::vector<T> &wav, size_t chunk_size) {
+  wenet::FeaturePipeline pipeline(config);
+  if (chunk_size == 0) chunk_size = wav.size();
+  for (size_t i = 0; i < wav.size(); i += chunk_size) {
+    pipeline.AcceptWaveform(wav.data() + i,
+                            std::min(chunk_size, wav.size() - i));
+  }
+  pipeline.set_input_finished();
+  wenet::FeatureMatrix feats;
+  pipeline.Read(pipeline.NumQueuedFrames(), &feats);
+  CHECK(pipeline.NumQueuedFrames() == 0);
+  return feats;
+}
+
+// First frame read as speech, one at a time, of silence then wav.
+int FirstSpeechFrame(const wenet::FeaturePipelineConfig &config,
+                     const std::vector<int16_t> &wav) {
+  wenet::FeaturePipeline pipeline(config);
+  pipeline.AcceptWaveform(std::vector<int16_t>(config.sample_rate, 0));
+  pipeline.AcceptWaveform(wav);
+  pipeline.set_input_finished();
+  wenet::FeatureMatrix feats;
+  bool has_speech = false;
+  for (int i = 0; pipeline.Read(1, &feats, &has_speech); ++i) {
+    if (has_speech) return i;
+  }
+  return -1;
+}
+
+bool Equal(const wenet::FeatureMatrix &a, const wenet::FeatureMatrix &b) {
+  return a.num_rows() == b.num_rows() && a.num_cols() == b.num_cols() &&
+         std::equal(a.data(), a.data() + a.size(), b.data());
+}
+
+}  // namespace
+
+int main() {
+  wenet::FeaturePipelineConfig config(40, 16000, wenet::CTC_TYPE_MODEL);
+  CHECK(config.downsampling > 1);
+  const std::vector<int16_t> wav = MakeWav(config.sample_rate);
+  std::vector<float> float_wav(wav.begin(), wav.end());
+
+  const wenet::FeatureMatrix whole = Extract(config, wav, 0);
+  LOG(INFO) << "whole wav, " << whole.num_rows() << " x " << whole.num_cols();
+  CHECK(whole.num_rows() > 0);
+  CHECK(whole.num_cols() ==
+        config.num_bins * (config.left_context + 1 + config.right_context));
+  CHECK(Equal(whole, Extract(config, float_wav, 0)));
+
+  const size_t chunk_sizes[] = {1, 37, 160, 1600};
+  for (size_t chunk_size : chunk_sizes) {
+    LOG(INFO) << "chunks of " << chunk_size << " samples";
+    CHECK(Equal(whole, Extract(config, wav, chunk_size)));
+    CHECK(Equal(whole, Extract(config, float_wav, chunk_size)));
+  }
+
+  // stereo, the wav and its reverse, kept or downmixed
+  std::vector<int16_t> stereo(wav.size() * 2);
+  for (size_t i = 0; i < wav.size(); ++i) {
+    stereo[2 * i] = wav[i];
+    stereo[2 * i + 1] = wav[wav.size() - 1 - i];
+  }
+  std::vector<float> float_stereo(stereo.begin(), stereo.end());
+  config.num_channels = 2;
+  for (int channel : {0, 1, -1}) {
+    LOG(INFO) << "stereo, channel " << channel;
+    config.channel = channel;
+    const wenet::FeatureMatrix feats = Extract(config, float_stereo, 0);
+    CHECK(Equal(feats, Extract(config, stereo, 0)));
+    CHECK(Equal(feats, Extract(config, stereo, 2 * 37)));
+    if (channel == 0) CHECK(Equal(feats, whole));
+  }
+  config.num_channels = 1;
+  config.channel = 0;
+
+  config.use_vad = true;
+  config.vad_config.pre_roll_frames = 0;
+  const int onset = FirstSpeechFrame(config, wav);
+  config.vad_config.pre_roll_frames = 20;
+  const int pre_roll_onset = FirstSpeechFrame(config, wav);
+  LOG(INFO) << "speech onset " << onset << ", with pre-roll "
+            << pre_roll_onset;
+  CHECK(onset > 0);
+  CHECK(pre_roll_onset == onset - 7);  // 20 frames in downsampling 3
+  return 0;
+}
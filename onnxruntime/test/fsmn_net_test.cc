@@ -0,0 +1,114 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Streams data/tiny_fsmn_input.txt through data/tiny_fsmn.nnet in chunks
+// of different sizes and checks the output against the numpy reference
+// of data/gen_tiny_fsmn.py. Run once per SIMD level, see WENET_SIMD.
+//
+// Usage: fsmn_net_test data_dir
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "kws/fsmn_net.h"
+#include "utils/cpu_features.h"
+#include "utils/log.h"
+
+namespace {
+
+std::vector<float> ReadMatrix(const std::string &path) {
+  std::ifstream in(path);
+  CHECK(in.good());
+  std::vector<float> values;
+  float value;
+  while (in >> value) values.push_back(value);
+  return values;
+}
+
+// Max abs difference to reference of the whole input run in chunks,
+// chunk_sizes repeated until the input ends.
+float StreamDiff(const wekws::FsmnNet &net, const std::vector<float> &input,
+                 const std::vector<float> &reference,
+                 const std::vector<int> &chunk_sizes) {
+  const int num_frames = input.size() / net.input_dim();
+  std::vector<float> cache[2];
+  cache[0].assign(net.cache_size(), 0.0f);
+  cache[1].assign(net.cache_size(), 0.0f);
+  std::vector<float> output(reference.size());
+  wekws::FsmnNet::Workspace workspace;
+  int cur = 0;
+  for (int t = 0, k = 0; t < num_frames; ++k) {
+    int n = std::min(chunk_sizes[k % chunk_sizes.size()], num_frames - t);
+    net.Forward(input.data() + t * net.input_dim(), n, cache[cur].data(),
+                cache[1 - cur].data(), output.data() + t * net.output_dim(),
+                &workspace);
+    cur = 1 - cur;
+    t += n;
+  }
+  float diff = 0.0f;
+  for (size_t i = 0; i < output.size(); ++i) {
+    diff = std::max(diff, std::fabs(output[i] - reference[i]));
+  }
+  return diff;
+}
+
+// A malformed <Fsmn> property is reported as a bad net.
+bool RejectsBadOrder(const std::string &text) {
+  const std::string good = "<LOrder> 4 ";
+  std::string bad = text;
+  size_t pos = bad.find(good);
+  CHECK(pos != std::string::npos);
+  bad.replace(pos, good.size(), "<LOrder> 4x ");
+  try {
+    wekws::FsmnNet net(bad.data(), bad.size());
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    LOG(FATAL) << "Usage: fsmn_net_test data_dir";
+  }
+  const std::string dir = argv[1];
+  wekws::FsmnNet net(dir + "/tiny_fsmn.nnet");
+  std::vector<float> input = ReadMatrix(dir + "/tiny_fsmn_input.txt");
+  std::vector<float> reference = ReadMatrix(dir + "/tiny_fsmn_output.txt");
+  CHECK(input.size() % net.input_dim() == 0);
+  CHECK(reference.size() ==
+        input.size() / net.input_dim() * net.output_dim());
+  LOG(INFO) << "SIMD level " << wenet::GetSimdLevel();
+
+  const std::vector<std::vector<int>> chunk_sizes = {
+      {1000}, {1}, {2}, {3}, {7, 1, 16, 5}, {1, 1, 4, 9, 2}};
+  for (const auto &sizes : chunk_sizes) {
+    float diff = StreamDiff(net, input, reference, sizes);
+    LOG(INFO) << "chunks of " << sizes[0] << "..., max diff " << diff;
+    CHECK(diff < 1e-5f);
+  }
+
+  std::ifstream in(dir + "/tiny_fsmn.nnet");
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  CHECK(RejectsBadOrder(text));
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UTILS_CPU_FEATURES_H_
+#define UTILS_CPU_FEATURES_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WENET_X86 1
+#endif
+
+namespace wenet {
+
+enum SimdLevel {
+  SIMD_SCALAR = 0,
+  SIMD_SSE2 = 1,
+  SIMD_AVX2 = 2  // AVX2 + FMA
+};
+
+// Widest instruction set supported by the running cpu. The environment
+// variable WENET_SIMD={scalar,sse2,avx2} caps it, which is useful to compare
+// the kernels against each other.
+inline SimdLevel DetectSimdLevel() {
+  SimdLevel level = SIMD_SCALAR;
+#ifdef WENET_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) level = SIMD_SSE2;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    level = SIMD_AVX2;
+  }
+#endif
+  const char* cap = getenv("WENET_SIMD");
+  if (cap != nullptr) {
+    SimdLevel max_level = level;
+    if (strcmp(cap, "scalar") == 0) max_level = SIMD_SCALAR;
+    if (strcmp(cap, "sse2") == 0) max_level = SIMD_SSE2;
+    if (max_level < level) level = max_level;
+  }
+  return level;
+}
+
+// Detected once per process.
+inline SimdLevel GetSimdLevel() {
+  static const SimdLevel level = DetectSimdLevel();
+  return level;
+}
+
+}  // namespace wenet
+
+#endif  // UTILS_CPU_FEATURES_H_
@@ -0,0 +1,79 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UTILS_MAPPED_FILE_H_
+#define UTILS_MAPPED_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+
+namespace wenet {
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile() : data_(nullptr), size_(0) {}
+  explicit MappedFile(const std::string& filename) : MappedFile() {
+    Open(filename);
+  }
+  ~MappedFile() { Close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Return false if the file cannot be opened or mapped.
+  bool Open(const std::string& filename) {
+    Close();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0) {
+      void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        ok = false;
+      } else {
+        data_ = static_cast<const char*>(data);
+        size_ = st.st_size;
+        // the file is usually read once from start to end
+        madvise(data, size_, MADV_SEQUENTIAL);
+      }
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    return ok;
+  }
+
+  void Close() {
+    if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+}  // namespace wenet
+
+#endif  // UTILS_MAPPED_FILE_H_
@@ -0,0 +1,41 @@
+// Copyright (c) 2024 Yang Chen (cyang8050@163.com)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UTILS_TIMER_H_
+#define UTILS_TIMER_H_
+
+#include <chrono>
+
+namespace wenet {
+
+class Timer {
+ public:
+  Timer() : time_start_(std::chrono::steady_clock::now()) {}
+
+  void Reset() { time_start_ = std::chrono::steady_clock::now(); }
+
+  // Milliseconds since the construction or the last Reset().
+  double Elapsed() const {
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - time_start_;
+    return elapsed.count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point time_start_;
+};
+
+}  // namespace wenet
+
+#endif  // UTILS_TIMER_H_